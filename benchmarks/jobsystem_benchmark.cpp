@@ -0,0 +1,115 @@
+// Scaling of the job system from 1 to 64 threads on two workloads:
+//  - cull:  frustum tests over a large box list with parallelFor, as the
+//           frame pipeline does (coarse jobs, little scheduling overhead)
+//  - jobs:  many tiny independent jobs behind one counter, plus a
+//           dependent job per batch (measures the scheduler itself)
+// Thread counts above the core count oversubscribe and should flatten out.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "frustum.h"
+#include "jobsystem.h"
+
+namespace {
+
+constexpr size_t BOX_COUNT = 1 << 20;
+constexpr size_t CULL_GRAIN = 1024;
+constexpr int TINY_BATCHES = 64;
+constexpr int TINY_JOBS_PER_BATCH = 2048;
+constexpr int REPEATS = 7;
+
+struct Box {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Best of REPEATS runs, in milliseconds
+template <typename F>
+double bestOf(F &&run) {
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++) {
+        Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+double benchCull(JobSystem &jobs, const std::vector<Box> &boxes, const glm::mat4 &viewProj) {
+    std::atomic<size_t> count{0};
+    return bestOf([&] {
+        count = 0;
+        jobs.parallelFor(boxes.size(), CULL_GRAIN, [&](size_t begin, size_t end) {
+            size_t local = 0;
+            for (size_t i = begin; i < end; i++) {
+                local += isBoxInFrustum(viewProj, boxes[i].min, boxes[i].max);
+            }
+            count += local;
+        });
+    });
+}
+
+double benchTinyJobs(JobSystem &jobs) {
+    std::atomic<uint64_t> sink{0};
+    return bestOf([&] {
+        JobCounter all;
+        for (int b = 0; b < TINY_BATCHES; b++) {
+            auto batch = std::make_shared<JobCounter>();
+            for (int j = 0; j < TINY_JOBS_PER_BATCH; j++) {
+                jobs.run([&sink, j] {
+                    uint64_t h = j;
+                    for (int k = 0; k < 64; k++) h = h * 6364136223846793005ull + 1442695040888963407ull;
+                    sink.fetch_add(h & 1, std::memory_order_relaxed);
+                }, batch.get());
+            }
+            // Runs once the whole batch is done; keeps the counter alive
+            jobs.runAfter(*batch, [batch] {}, &all);
+        }
+        jobs.wait(all);
+    });
+}
+
+}
+
+int main() {
+    std::vector<Box> boxes(BOX_COUNT);
+    std::mt19937 rng(1230);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> size(0.1f, 4.f);
+    for (Box &b : boxes) {
+        glm::vec3 p(position(rng), position(rng), position(rng));
+        b.min = p;
+        b.max = p + glm::vec3(size(rng), size(rng), size(rng));
+    }
+    glm::mat4 viewProj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 150.f) *
+                         glm::lookAt(glm::vec3(0.f, 0.f, 0.f), glm::vec3(1.f, 0.2f, 0.5f), glm::vec3(0.f, 1.f, 0.f));
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %10s %8s %10s %8s\n", "threads", "cull ms", "speedup", "jobs ms", "speedup");
+
+    double cullBase = 0.0, jobsBase = 0.0;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        // The calling thread helps while it waits, so it counts as one
+        JobSystem jobs(threads - 1);
+
+        double cullMs = benchCull(jobs, boxes, viewProj);
+        double jobsMs = benchTinyJobs(jobs);
+        if (threads == 1) {
+            cullBase = cullMs;
+            jobsBase = jobsMs;
+        }
+        std::printf("%8d %10.2f %8.2f %10.2f %8.2f\n", threads, cullMs, cullBase / cullMs, jobsMs, jobsBase / jobsMs);
+    }
+    return 0;
+}
@@ -4,23 +4,28 @@ in vec2 uv;
 
 uniform sampler2D image;
 uniform bool horizontal;
+// Part of the pooled texture holding this frame's image (see RenderTargetPool)
+uniform vec2 uvScale;
 
 // 5-tap Gaussian weights
 uniform float weight[5] = float[] (0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
 
 void main() {
     vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
-    vec3 result = texture(image, uv).rgb * weight[0];
+    vec2 texUV = uv * uvScale;
+    // Taps past the valid sub-rect would read stale texels; clamp them to its edge
+    vec2 uvMax = uvScale - 0.5 * tex_offset;
+    vec3 result = texture(image, texUV).rgb * weight[0];
 
     if(horizontal) {
         for(int i = 1; i < 5; ++i) {
-            result += texture(image, uv + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, uv - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += texture(image, min(texUV + vec2(tex_offset.x * i, 0.0), uvMax)).rgb * weight[i];
+            result += texture(image, texUV - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
         }
     } else {
         for(int i = 1; i < 5; ++i) {
-            result += texture(image, uv + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-            result += texture(image, uv - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+            result += texture(image, min(texUV + vec2(0.0, tex_offset.y * i), uvMax)).rgb * weight[i];
+            result += texture(image, texUV - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
         }
     }
     FragColor = vec4(result, 1.0);
@@ -5,10 +5,39 @@ in vec2 uv;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform float exposure;
+// Off when the scene has nothing emissive (the blur passes were culled)
+uniform bool useBloom;
+// Parts of the pooled textures holding this frame's image and bloom (see
+// RenderTargetPool); they differ once the temporal resolve has upscaled
+uniform vec2 uvScale;
+uniform vec2 bloomUVScale;
+// Unsharp-mask strength, non-zero while rendering below output resolution
+uniform float sharpness;
 
 void main() {
-    vec3 hdrColor = texture(scene, uv).rgb;
-    vec3 bloomColor = texture(bloomBlur, uv).rgb;
+    // Bilinear upscale of the rendered sub-rect, kept off the stale texels
+    // around it
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uvMax = uvScale - 0.5 * texel;
+    vec2 sceneUV = min(uv * uvScale, uvMax);
+
+    vec3 hdrColor = texture(scene, sceneUV).rgb;
+    vec2 bloomUV = min(uv * bloomUVScale, bloomUVScale - 0.5 / vec2(textureSize(bloomBlur, 0)));
+    vec3 bloomColor = useBloom ? texture(bloomBlur, bloomUV).rgb : vec3(0.0);
+
+    // Sharpen what the upscale softened: push away from the 4 neighbours'
+    // average, clamped to their range so edges don't ring
+    if (sharpness > 0.0) {
+        vec3 n = texture(scene, min(sceneUV + vec2(0.0, texel.y), uvMax)).rgb;
+        vec3 s = texture(scene, sceneUV - vec2(0.0, texel.y)).rgb;
+        vec3 e = texture(scene, min(sceneUV + vec2(texel.x, 0.0), uvMax)).rgb;
+        vec3 w = texture(scene, sceneUV - vec2(texel.x, 0.0)).rgb;
+
+        vec3 lo = min(min(min(n, s), min(e, w)), hdrColor);
+        vec3 hi = max(max(max(n, s), max(e, w)), hdrColor);
+        vec3 average = 0.25 * (n + s + e + w);
+        hdrColor = clamp(hdrColor + sharpness * (hdrColor - average), lo, hi);
+    }
 
     // 1. Additive Blending
     vec3 result = hdrColor + bloomColor;
@@ -7,29 +7,63 @@ in vec2 uv; // Input from fullscreen_quad.vert
 // Samplers for the G-Buffer textures
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
+uniform usampler2D gMaterial;
 uniform sampler2D gEmissive;
 
-// -------- Global coefficients (match C++ names) --------
-uniform float k_a;
-uniform float k_d;
-uniform float k_s;
-
-uniform vec3 camPos;
-
-// light description (Copied from default.frag)
-struct Light {
-    int   type;      // 0 = point, 1 = directional, 2 = spot
-    vec3  color;
-    vec3  pos;
-    vec3  dir;
-    vec3  atten;
-    float angle;
-    float penumbra;  // outer - inner
+// Material table, 3 texels per material (see MaterialTable)
+uniform samplerBuffer materials;
+
+// Which terms this invocation evaluates (see Realtime::lightingPass)
+const int LIGHTING_FULL = 0;         // everything, at the render resolution
+const int LIGHTING_HALF_DIFFUSE = 1; // diffuse irradiance only, into a half-res target
+const int LIGHTING_SPECULAR = 2;     // everything else, plus the upsampled diffuse
+uniform int lightingMode;
+// Half-res diffuse irradiance (albedo not applied), for LIGHTING_SPECULAR
+uniform sampler2D halfDiffuse;
+// Rendered part of the G-buffer, in pixels
+uniform ivec2 renderSize;
+
+// Edge-stopping strengths of the bilateral upsample
+const float DEPTH_SHARPNESS = 32.0;  // per relative depth difference
+const float NORMAL_SHARPNESS = 16.0; // exponent on the normals' cosine
+
+// Must match FrameUniforms in uniformblocks.h
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;         // jittered
+    vec4 camPos;
+    mat4 viewProj;     // unjittered
+    mat4 prevViewProj; // unjittered, previous frame
 };
 
-uniform int   numLights;
-uniform Light lights[8];
+// Light lists, split by type and preprocessed on the CPU (see LightList)
+struct DirectionalLight {
+    vec4 toLight;     // normalized
+    vec4 color;
+};
+
+struct PointLight {
+    vec4 posRadius;
+    vec4 color;
+    vec4 atten;
+};
+
+struct SpotLight {
+    vec4 posRadius;
+    vec4 color;
+    vec4 atten;
+    vec4 dirCosOuter; // normalized direction, cos(outer angle)
+    vec4 cone;        // x = 1 / (cos inner - cos outer)
+};
+
+// Must match LightUniforms in uniformblocks.h
+layout(std140) uniform LightData {
+    vec4  coeffs;     // k_a, k_d, k_s
+    ivec4 lightCount; // directional, point, spot
+    DirectionalLight directionals[8];
+    PointLight points[8];
+    SpotLight spots[8];
+};
 
 // ----------------------------------------------------
 // 🛠️ DEBUG SWITCH: Change this value to visualize a buffer
@@ -48,79 +82,101 @@ float distanceFalloff(vec3 coeffs, float d) {
     return min(1.0, att);
 }
 
-// spotFalloff (Copied from default.frag)
-float spotFalloff(float angleToAxis, float angle, float penumbra) {
-    if (angleToAxis >= angle) {
-        return 0.0;
-    }
+// Falloff from 1 inside the inner cone to 0 at the outer cone, ramped on the
+// cosine of the angle to the axis (no acos)
+float spotFalloff(SpotLight light, vec3 L) {
+    float t = clamp((dot(-L, light.dirCosOuter.xyz) - light.dirCosOuter.w) * light.cone.x, 0.0, 1.0);
+    return t * t;
+}
 
-    if (penumbra <= 0.0) {
-        return 1.0;
-    }
+struct Material {
+    vec3 diffuse;
+    vec3 specular;  // zero if the material has no highlight
+    float shininess;
+};
 
-    float t = angleToAxis - (angle - penumbra);
-    return t > 0.0 ? pow(1.0 - t/penumbra, 2.0) : 1.0;
+Material fetchMaterial(uint id) {
+    int base = int(id) * 3;
+    Material m;
+    m.diffuse = texelFetch(materials, base).rgb;
+    vec4 specShininess = texelFetch(materials, base + 1);
+    m.specular = specShininess.rgb;
+    m.shininess = specShininess.a;
+    return m;
 }
 
-// Light contribution function (Adapted from default.frag)
-vec3 lightContrib(Light light, vec3 wsPosition, vec3 wsNormal, vec3 camPos, vec3 albedoColor) {
-    float shininess = 32.0; // Placeholder shininess
-    vec3 cSpecular = vec3(1.0); // Placeholder white specular color
+// Phong diffuse + specular for one light (Adapted from default.frag).
+// Surfaces facing away get nothing, without branching.
+vec3 phong(vec3 N, vec3 V, vec3 L, vec3 lightColor, Material mat) {
+    float k_d = coeffs.y;
+    float k_s = coeffs.z;
 
-    vec3 N = normalize(wsNormal);
-    vec3 V = normalize(camPos - wsPosition);
+    float NdotL = dot(N, L);
+    float facing = float(NdotL > 0.0);
 
-    vec3 L;
-    float d = 0.0;
-    float attenuation = 1.0;
+    vec3 diffuse  = k_d * mat.diffuse * max(NdotL, 0.0) * lightColor;
 
-    if (light.type == 0 || light.type == 2) { // Point or Spot
-        L = light.pos - wsPosition;
-        d = length(L);
-        L = normalize(L);
+    vec3 R        = reflect(-L, N);
+    float sTerm   = pow(max(dot(R, V), 0.0), mat.shininess);
+    vec3 specular = k_s * mat.specular * sTerm * lightColor;
 
-        attenuation = distanceFalloff(light.atten, d);
+    return facing * (diffuse + specular);
+}
 
-        if (light.type == 2) { // Spot
-            float angleToAxis = acos(dot(-L, normalize(light.dir)));
-            attenuation *= spotFalloff(angleToAxis, light.angle, light.penumbra);
+// Joint-bilateral upsample of the half-res diffuse irradiance: the four
+// nearest half-res texels, bilinearly weighted, each weighted down when the
+// surface it was lit for is at a different depth or faces another way
+vec3 upsampleDiffuse(ivec2 pixel, vec3 position, vec3 N) {
+    ivec2 halfSize = (renderSize + 1) / 2;
+    vec2 f = (vec2(pixel) + 0.5) * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(f));
+    vec2 t = f - vec2(base);
+    float depth = distance(camPos.xyz, position);
+
+    vec3 sum = vec3(0.0);
+    float total = 0.0;
+    // Used if every tap is rejected: the one closest in depth
+    vec3 closest = vec3(0.0);
+    float closestDiff = 1e30;
+    for (int i = 0; i < 4; i++) {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 tap = clamp(base + o, ivec2(0), halfSize - 1);
+        // The G-buffer texel the half-res texel was lit from
+        ivec2 guide = min(tap * 2, renderSize - 1);
+        vec3 tapPosition = texelFetch(gPosition, guide, 0).rgb;
+        vec3 tapNormal = texelFetch(gNormal, guide, 0).rgb;
+        vec3 irradiance = texelFetch(halfDiffuse, tap, 0).rgb;
+
+        float depthDiff = abs(distance(camPos.xyz, tapPosition) - depth) / depth;
+        vec2 bilinear = mix(1.0 - t, t, vec2(o));
+        float w = bilinear.x * bilinear.y
+                * exp(-DEPTH_SHARPNESS * depthDiff)
+                * pow(max(dot(N, tapNormal), 0.0), NORMAL_SHARPNESS);
+        sum += w * irradiance;
+        total += w;
+
+        if (depthDiff < closestDiff) {
+            closestDiff = depthDiff;
+            closest = irradiance;
         }
-
-    } else if (light.type == 1) { // Directional
-        L = normalize(light.dir);
-        attenuation = 1.0; // No falloff for directional
-    }
-
-    float NdotL = max(dot(N, L), 0.0);
-
-    // if light behind the surface
-    if (NdotL <= 0.0) {
-        return vec3(0.0);
-    }
-
-    // diffuse
-    vec3 diffuse  = k_d * albedoColor * NdotL * light.color;
-
-    // specular
-    vec3 specular = vec3(0.0);
-    if (shininess > 0.0 && k_s > 0.0) {
-        vec3 R      = reflect(-L, N);
-        float RdotV = max(dot(R, V), 0.0);
-        float sTerm = pow(RdotV, shininess);
-        specular    = k_s * cSpecular * sTerm * light.color;
     }
-
-    // each light will return its local phong contribution in RGB
-    return attenuation * (diffuse + specular);
+    return total > 1e-4 ? sum / total : closest;
 }
 
 
 void main() {
     // Read data from the G-Buffer textures
-    vec3 position  = texture(gPosition, uv).rgb;
-    vec3 normal    = texture(gNormal, uv).rgb;
-    vec4 albedo    = texture(gAlbedo, uv);
-    vec3 emissive  = texture(gEmissive, uv).rgb;
+    // Fetched by pixel: the G-buffer matches this pass's resolution, and only
+    // the bottom-left sub-rect of its pooled textures is valid. At half
+    // resolution one texel of every 2x2 block stands in for the block.
+    ivec2 pixel    = ivec2(gl_FragCoord.xy);
+    if (lightingMode == LIGHTING_HALF_DIFFUSE) {
+        pixel = min(pixel * 2, renderSize - 1);
+    }
+    vec3 position  = texelFetch(gPosition, pixel, 0).rgb;
+    vec3 normal    = texelFetch(gNormal, pixel, 0).rgb;
+    Material mat   = fetchMaterial(texelFetch(gMaterial, pixel, 0).r);
+    vec3 emissive  = texelFetch(gEmissive, pixel, 0).rgb;
 
     vec3 debug_color = vec3(0.0);
 
@@ -132,27 +188,61 @@ void main() {
     debug_color = normal * 0.5 + 0.5;   // Map [-1, 1] range to [0, 1] for color
 #elif DEBUG_VIEW == 3
     // 3. Albedo Buffer
-    debug_color = albedo.rgb;
+    debug_color = mat.diffuse;
 #elif DEBUG_VIEW == 4
     // 4. Emissive Buffer
     debug_color = emissive;
 #else
     // 0. Full Lighting Pass
 
-    // Use Albedo color as ambient/diffuse material color
-    vec3 albedoColor = albedo.rgb;
+    vec3 N = normalize(normal);
+    vec3 V = normalize(camPos.xyz - position);
 
-    // Ambient term
-    vec3 final_color = k_a * albedoColor;
+    // Diffuse colour doubles as the ambient material colour
+    vec3 albedo = mat.diffuse;
+    vec3 final_color = coeffs.x * albedo + emissive;
+    bool loopLights = true;
 
-    // Lights
-    int count = min(numLights, 8);
-    for (int i = 0; i < count; ++i) {
-        final_color += lightContrib(lights[i], position, normal, camPos, albedoColor);
+    if (lightingMode == LIGHTING_HALF_DIFFUSE) {
+        // Sky texels have no normal; they're never picked by the upsample
+        if (dot(normal, normal) == 0.0) {
+            fragColor = vec4(0.0);
+            return;
+        }
+        // Irradiance only: albedo goes back on at full resolution
+        final_color = vec3(0.0);
+        mat.diffuse = vec3(1.0);
+        mat.specular = vec3(0.0);
+    }
+    else if (lightingMode == LIGHTING_SPECULAR) {
+        final_color += albedo * upsampleDiffuse(pixel, position, N);
+        mat.diffuse = vec3(0.0);
+        // Materials without a highlight have nothing left to evaluate
+        loopLights = any(greaterThan(mat.specular, vec3(0.0)));
     }
 
-    // Add Emissive
-    final_color += emissive;
+    // One loop per light type; every pixel takes the same path
+    for (int i = 0; loopLights && i < lightCount.x; ++i) {
+        final_color += phong(N, V, directionals[i].toLight.xyz, directionals[i].color.rgb, mat);
+    }
+
+    for (int i = 0; loopLights && i < lightCount.y; ++i) {
+        vec3 toLight = points[i].posRadius.xyz - position;
+        float d = length(toLight);
+        vec3 L = toLight / d;
+
+        float attenuation = distanceFalloff(points[i].atten.xyz, d);
+        final_color += attenuation * phong(N, V, L, points[i].color.rgb, mat);
+    }
+
+    for (int i = 0; loopLights && i < lightCount.z; ++i) {
+        vec3 toLight = spots[i].posRadius.xyz - position;
+        float d = length(toLight);
+        vec3 L = toLight / d;
+
+        float attenuation = distanceFalloff(spots[i].atten.xyz, d) * spotFalloff(spots[i], L);
+        final_color += attenuation * phong(N, V, L, spots[i].color.rgb, mat);
+    }
 
     debug_color = final_color;
 #endif
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 fragColor;
+
+in vec2 uv;
+
+uniform sampler2D gEmissive;
+
+// Lighting pass for pixels classified as emissive-only: no diffuse or
+// specular response, so the result is just the emissive colour
+void main() {
+    fragColor = vec4(texelFetch(gEmissive, ivec2(gl_FragCoord.xy), 0).rgb, 1.0);
+}
@@ -4,19 +4,25 @@
 // Change vec3 to vec4 for gPosition, gNormal, and gEmissive to match GL_RGBA16F
 layout(location = 0) out vec4 gPosition;
 layout(location = 1) out vec4 gNormal;
-layout(location = 2) out vec4 gAlbedo;
+layout(location = 2) out uint gMaterial;
 layout(location = 3) out vec4 gEmissive;
+layout(location = 4) out vec2 gMotion; // screen-space (uv) motion since last frame
 
 in vec3 worldPos;
 in vec3 worldNormal;
+in vec4 currClip;
+in vec4 prevClip;
 
-uniform vec3 albedo;
-uniform vec3 emissive;
+// Index into the material table (see MaterialTable)
+uniform uint materialId;
+uniform samplerBuffer materials;
 
 void main() {
     // Must write a vec4 value to vec4 outputs
     gPosition = vec4(worldPos, 1.0);
     gNormal = vec4(normalize(worldNormal), 1.0);
-    gAlbedo = vec4(albedo, 1.0);
-    gEmissive = vec4(emissive, 1.0);
+    gMaterial = materialId;
+    // Emissive stays in the G-buffer as the bloom source
+    gEmissive = vec4(texelFetch(materials, int(materialId) * 3 + 2).rgb, 1.0);
+    gMotion = (currClip.xy / currClip.w - prevClip.xy / prevClip.w) * 0.5;
 }
@@ -4,11 +4,21 @@ layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inNormal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+
+// Must match FrameUniforms in uniformblocks.h
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;         // jittered
+    vec4 camPos;
+    mat4 viewProj;     // unjittered
+    mat4 prevViewProj; // unjittered, previous frame
+};
 
 out vec3 worldPos;
 out vec3 worldNormal;
+// Unjittered clip positions this frame and last, for the motion vector
+out vec4 currClip;
+out vec4 prevClip;
 
 void main() {
     vec4 wp = model * vec4(inPos, 1.0);
@@ -16,5 +26,9 @@ void main() {
 
     worldNormal = normalize(mat3(transpose(inverse(model))) * inNormal);
 
+    // The scene is static, so only the camera moves a surface point
+    currClip = viewProj * wp;
+    prevClip = prevViewProj * wp;
+
     gl_Position = proj * view * wp;
 }
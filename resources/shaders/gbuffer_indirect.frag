@@ -0,0 +1,24 @@
+#version 430 core
+
+// Same targets as gbuffer.frag, but the material comes from the vertex shader
+layout(location = 0) out vec4 gPosition;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out uint gMaterial;
+layout(location = 3) out vec4 gEmissive;
+layout(location = 4) out vec2 gMotion; // screen-space (uv) motion since last frame
+
+in vec3 worldPos;
+in vec3 worldNormal;
+in vec4 currClip;
+in vec4 prevClip;
+flat in uint materialId;
+
+layout(binding = 4) uniform samplerBuffer materials;
+
+void main() {
+    gPosition = vec4(worldPos, 1.0);
+    gNormal = vec4(normalize(worldNormal), 1.0);
+    gMaterial = materialId;
+    gEmissive = vec4(texelFetch(materials, int(materialId) * 3 + 2).rgb, 1.0);
+    gMotion = (currClip.xy / currClip.w - prevClip.xy / prevClip.w) * 0.5;
+}
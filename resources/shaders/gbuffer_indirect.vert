@@ -0,0 +1,53 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inNormal;
+
+// Must match IndirectObject in indirectrenderer.h
+struct Object {
+    mat4 model;
+    mat4 normalMatrix;
+    uvec4 material; // x = material ID
+};
+
+layout(std430, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+// Object index for each draw of the multi-draw, indexed by gl_DrawIDARB
+layout(std430, binding = 1) readonly buffer DrawObjects {
+    uint drawObjects[];
+};
+
+// Must match FrameUniforms in uniformblocks.h
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 proj;         // jittered
+    vec4 camPos;
+    mat4 viewProj;     // unjittered
+    mat4 prevViewProj; // unjittered, previous frame
+};
+
+out vec3 worldPos;
+out vec3 worldNormal;
+// Unjittered clip positions this frame and last, for the motion vector
+out vec4 currClip;
+out vec4 prevClip;
+flat out uint materialId;
+
+void main() {
+    Object o = objects[drawObjects[gl_DrawIDARB]];
+
+    vec4 wp = o.model * vec4(inPos, 1.0);
+    worldPos = wp.xyz;
+    worldNormal = normalize(mat3(o.normalMatrix) * inNormal);
+
+    materialId = o.material.x;
+
+    // The scene is static, so only the camera moves a surface point
+    currClip = viewProj * wp;
+    prevClip = prevViewProj * wp;
+
+    gl_Position = proj * view * wp;
+}
@@ -0,0 +1,102 @@
+#version 330 core
+out vec4 fragColor;
+
+// Samplers for the G-Buffer textures
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform usampler2D gMaterial;
+
+// Material table, 3 texels per material (see MaterialTable)
+uniform samplerBuffer materials;
+
+// Must match FrameUniforms in uniformblocks.h
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;         // jittered
+    vec4 camPos;
+    mat4 viewProj;     // unjittered
+    mat4 prevViewProj; // unjittered, previous frame
+};
+
+struct DirectionalLight {
+    vec4 toLight;
+    vec4 color;
+};
+
+struct PointLight {
+    vec4 posRadius;
+    vec4 color;
+    vec4 atten;
+};
+
+// Point lights arrive as spots whose cone covers every direction
+struct SpotLight {
+    vec4 posRadius;
+    vec4 color;
+    vec4 atten;
+    vec4 dirCosOuter; // normalized direction, cos(outer angle)
+    vec4 cone;        // x = 1 / (cos inner - cos outer)
+};
+
+// Must match LightUniforms in uniformblocks.h (only coeffs is read here)
+layout(std140) uniform LightData {
+    vec4  coeffs;     // k_a, k_d, k_s
+    ivec4 lightCount;
+    DirectionalLight directionals[8];
+    PointLight points[8];
+    SpotLight spots[8];
+};
+
+// Must match VolumeLightUniforms in uniformblocks.h
+layout(std140) uniform VolumeLight {
+    mat4      model;
+    SpotLight light;
+};
+
+// distanceFalloff (Copied from deferredLighting.frag)
+float distanceFalloff(vec3 coeffs, float d) {
+    float denom = coeffs.x + d * (coeffs.y + coeffs.z * d);
+    float att = 1.0 / max(denom, 1e-6);
+    return min(1.0, att);
+}
+
+// spotFalloff (Copied from deferredLighting.frag)
+float spotFalloff(SpotLight light, vec3 L) {
+    float t = clamp((dot(-L, light.dirCosOuter.xyz) - light.dirCosOuter.w) * light.cone.x, 0.0, 1.0);
+    return t * t;
+}
+
+void main() {
+    // The volume covers the pixel; fetch the surface it was marked for
+    ivec2 pixel      = ivec2(gl_FragCoord.xy);
+    vec3 position    = texelFetch(gPosition, pixel, 0).rgb;
+    vec3 N           = normalize(texelFetch(gNormal, pixel, 0).rgb);
+
+    int material     = int(texelFetch(gMaterial, pixel, 0).r) * 3;
+    vec3 albedoColor = texelFetch(materials, material).rgb;
+    vec4 specShininess = texelFetch(materials, material + 1);
+    vec3 cSpecular   = specShininess.rgb; // zero if the material has no highlight
+    float shininess  = specShininess.a;
+    float k_d = coeffs.y;
+    float k_s = coeffs.z;
+
+    vec3 toLight = light.posRadius.xyz - position;
+    float d = length(toLight);
+    vec3 L = toLight / d;
+
+    float attenuation = distanceFalloff(light.atten.xyz, d) * spotFalloff(light, L);
+
+    // No discard or early return: the fragment must still reach the stencil
+    // op that clears this light's mark
+    float NdotL = dot(N, L);
+    float facing = float(NdotL > 0.0);
+
+    vec3 diffuse  = k_d * albedoColor * max(NdotL, 0.0) * light.color.rgb;
+
+    vec3 V        = normalize(camPos.xyz - position);
+    vec3 R        = reflect(-L, N);
+    vec3 specular = k_s * cSpecular * pow(max(dot(R, V), 0.0), shininess) * light.color.rgb;
+
+    // Added onto the fullscreen pass result by additive blending
+    fragColor = vec4(facing * attenuation * (diffuse + specular), 1.0);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+
+layout(location = 0) in vec3 inPos;
+
+// Must match FrameUniforms in uniformblocks.h
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;         // jittered
+    vec4 camPos;
+    mat4 viewProj;     // unjittered
+    mat4 prevViewProj; // unjittered, previous frame
+};
+
+struct SpotLight {
+    vec4 posRadius;
+    vec4 color;
+    vec4 atten;
+    vec4 dirCosOuter;
+    vec4 cone;
+};
+
+// Must match VolumeLightUniforms in uniformblocks.h
+layout(std140) uniform VolumeLight {
+    mat4      model;
+    SpotLight light;
+};
+
+void main() {
+    gl_Position = proj * view * model * vec4(inPos, 1.0);
+}
@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 uv;
+
+// This frame's lit image, rendered below output resolution with a
+// sub-pixel jitter, and its motion vectors (see gbuffer.frag)
+uniform sampler2D current;
+uniform sampler2D motion;
+// Last frame's resolved image, at output resolution
+uniform sampler2D history;
+
+// Parts of the pooled textures holding the rendered and resolved images
+uniform vec2 renderUVScale;
+uniform vec2 outputUVScale;
+// This frame's jitter, in uv units
+uniform vec2 jitter;
+// False on the first frame and after a cut; just upscale the current frame
+uniform bool historyValid;
+
+// Weight of the new frame in the running average
+const float CURRENT_WEIGHT = 0.1;
+
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(current, 0));
+    vec2 renderMax = renderUVScale - 0.5 * texel;
+
+    // Undo the jitter so the current sample lands where the pixel centre is
+    vec2 currentUV = min(max((uv + jitter) * renderUVScale, 0.5 * texel), renderMax);
+    vec3 color = texture(current, currentUV).rgb;
+
+    // Range of the 3x3 rendered neighbourhood; history outside it belongs to
+    // something that's no longer visible here
+    ivec2 centre = ivec2(uv * renderUVScale * vec2(textureSize(current, 0)));
+    ivec2 last = ivec2(renderMax / texel);
+    vec3 lo = color;
+    vec3 hi = color;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 c = texelFetch(current, clamp(centre + ivec2(x, y), ivec2(0), last), 0).rgb;
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+    }
+
+    vec2 velocity = texelFetch(motion, clamp(centre, ivec2(0), last), 0).rg;
+    vec2 prevUV = uv - velocity;
+    if (!historyValid || any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0)))) {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    vec2 historyTexel = 1.0 / vec2(textureSize(history, 0));
+    vec2 historyUV = min(prevUV * outputUVScale, outputUVScale - 0.5 * historyTexel);
+    vec3 previous = clamp(texture(history, historyUV).rgb, lo, hi);
+
+    FragColor = vec4(mix(previous, color, CURRENT_WEIGHT), 1.0);
+}
@@ -2,25 +2,49 @@
 
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QOpenGLContext>
+#include <QGuiApplication>
+#include <QMetaObject>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "settings.h"
-#include "utils/cube.h"
-#include "utils/cone.h"
-#include "utils/sphere.h"
-#include "utils/cylinder.h"
+#include "utils/primitivemesh.h"
 #include "shaderloader.h"
 #include "scenedata.h"
 #include "utils/debug.h"
+#include "utils/uniformblocks.h"
+#include "utils/stencilclass.h"
+#include "utils/jobsystem.h"
+#include "utils/framearena.h"
+#include "utils/allocationcounter.h"
+
+namespace {
+// Lit scene, bloom and temporal history
+const RenderTargetFormat HDR_FORMAT = {GL_RGB16F, GL_RGB, GL_FLOAT, GL_LINEAR};
+
+// Element `index` (from 1) of the Halton sequence in `base`, in [0, 1)
+float halton(int index, int base) {
+    float f = 1.f, r = 0.f;
+    for (; index > 0; index /= base) {
+        f /= base;
+        r += f * (index % base);
+    }
+    return r;
+}
+}
 
 Realtime::Realtime(QWidget *parent)
     : QOpenGLWidget(parent),
     m_mouseDown(false),
     m_camPos(0.f, 2.f, 5.f),
     m_camLook(0.f, 0.f, -1.f),
-    m_camUp(0.f, 1.f, 0.f)
+    m_camUp(0.f, 1.f, 0.f),
+    m_renderTargets(m_glState),
+    m_renderGraph(m_glState, m_renderTargets),
+    m_gbuffer(m_glState, m_renderTargets)
 {
     setMouseTracking(true);
     setFocusPolicy(Qt::StrongFocus);
@@ -33,46 +57,132 @@ Realtime::Realtime(QWidget *parent)
     m_keyMap[Qt::Key_E] = false;
     m_keyMap[Qt::Key_Space] = false;
     m_keyMap[Qt::Key_Control] = false;
+
+    // The render thread starts with whatever settings exist now
+    m_snapshots.publishSettings(settings);
+    m_snapshot = m_snapshots.latest();
+
+    // Qt composes the widget and recreates its framebuffer on the GUI
+    // thread; the render thread must not be drawing meanwhile
+    connect(this, &QOpenGLWidget::aboutToCompose, this, [this] { m_renderMutex.lock(); }, Qt::DirectConnection);
+    connect(this, &QOpenGLWidget::frameSwapped, this, [this] { m_renderMutex.unlock(); }, Qt::DirectConnection);
+    connect(this, &QOpenGLWidget::aboutToResize, this, [this] { m_renderMutex.lock(); }, Qt::DirectConnection);
+    connect(this, &QOpenGLWidget::resized, this, [this] { m_renderMutex.unlock(); }, Qt::DirectConnection);
+
+    // drawFrame always leaves the next frame's culling queued on the job
+    // system; let it finish before the render thread goes
+    connect(&m_renderThread, &QThread::finished, this, [this] { m_framePipeline.invalidate(); },
+            Qt::DirectConnection);
+
+    m_renderWorker.moveToThread(&m_renderThread);
+    m_renderThread.start();
+}
+
+Realtime::~Realtime() {
+    stopRenderThread();
 }
 
 void Realtime::finish() {
+    stopRenderThread();
     makeCurrent();
 
+    m_glState.releaseVertexArray(m_quadVAO);
     glDeleteVertexArrays(1, &m_quadVAO);
     glDeleteBuffers(1, &m_quadVBO);
+    m_glState.releaseProgram(m_gbufferShader);
+    m_glState.releaseProgram(m_deferredShader);
+    m_glState.releaseProgram(m_emissiveShader);
+    m_glState.releaseProgram(m_resolveShader);
     glDeleteProgram(m_gbufferShader);
     glDeleteProgram(m_deferredShader);
+    glDeleteProgram(m_emissiveShader);
+    glDeleteProgram(m_resolveShader);
 
-    for (auto& kv : m_shapeVAOs) {
-        glDeleteVertexArrays(1, &kv.second);
-    }
+    m_staticBatcher.destroy(m_geometry);
+    m_indirect.destroy(m_glState);
+    m_lightVolumes.destroy(m_geometry, m_glState);
+    m_materials.destroy();
+    m_geometry.destroy(m_glState);
+    m_uploadRing.destroy();
+
+    m_renderGraph.destroy();
+    m_renderTargets.destroy();
+    m_dynamicResolution.destroy();
 
     doneCurrent();
 }
 
 void Realtime::sceneChanged() {
-    bool success = SceneParser::parse(settings.sceneFilePath, m_renderData);
+    // Parsed here on the GUI thread; the render thread picks the finished
+    // scene up at its next frame
+    auto scene = std::make_shared<RenderData>();
+    bool success = SceneParser::parse(settings.sceneFilePath, *scene);
     if (!success) {
         std::cerr << "Error parsing scene: " << settings.sceneFilePath << std::endl;
         return;
     }
 
+    m_snapshots.publishSettings(settings);
+    m_snapshots.publishScene(std::move(scene));
+    requestFrame();
+}
+
+void Realtime::settingsChanged() {
+    m_snapshots.publishSettings(settings);
+    requestFrame();
+}
+
+// Render thread, context current
+void Realtime::applySnapshot() {
+    const Settings &frameSettings = *m_snapshot.settings;
+    bool newScene = m_snapshot.scene && m_snapshot.sceneGeneration != m_appliedSceneGeneration;
+    bool newSettings = m_snapshot.settingsRevision != m_appliedSettingsRevision;
+    m_appliedSceneGeneration = m_snapshot.sceneGeneration;
+    m_appliedSettingsRevision = m_snapshot.settingsRevision;
+    if (!newScene && !newSettings) return;
+
+    // Projection follows the near/far settings and the scene's height angle
+    float aspectRatio = (float)m_gbuffer.getWidth() / (float)m_gbuffer.getHeight();
+    if (!newScene) {
+        m_camera.setProjectionMatrix(aspectRatio, frameSettings.nearPlane, frameSettings.farPlane,
+                                     m_renderData.cameraData.heightAngle);
+        m_framePipeline.invalidate();
+        return;
+    }
+
+    m_renderData = *m_snapshot.scene;
+
     // 🔧 FIX: Update camera to match the new scene
     SceneCameraData& camData = m_renderData.cameraData;
     m_camera.setViewMatrix(camData.pos, camData.look, camData.up);
+    m_camera.setProjectionMatrix(aspectRatio, frameSettings.nearPlane, frameSettings.farPlane, camData.heightAngle);
+
+    // Split and precompute the lights once instead of per frame/pixel
+    m_lightList.build(m_renderData, m_lightVolumes.isReady());
+
+    // Bloom is skipped entirely for scenes without emissive materials
+    m_sceneHasEmissive = false;
+    for (const SceneMaterial &material : m_renderData.shapes.materialTable) {
+        const SceneColor &e = material.cEmissive;
+        if (e.r > 0.f || e.g > 0.f || e.b > 0.f) {
+            m_sceneHasEmissive = true;
+            break;
+        }
+    }
 
-    // Update projection with new height angle/planes
-    float aspectRatio = (float)width() / (float)height();
-    m_camera.setProjectionMatrix(aspectRatio, settings.nearPlane, settings.farPlane, camData.heightAngle);
+    // Every draw path below refers to materials by their table ID
+    m_materials.build(m_renderData);
 
-    update();
-}
+    // Nothing in the scene moves after parsing, so bake it into static batches
+    // (the indirect path already submits the whole scene in one call)
+    if (m_useStaticBatching && !m_indirect.isReady()) {
+        m_staticBatcher.build(m_renderData, m_materials, frameSettings.shapeParameter1,
+                              frameSettings.shapeParameter2, m_geometry, m_glState);
+    }
+    updateCullObjects();
 
-void Realtime::settingsChanged() {
-    // If settings affect projection (near/far), update it here
-    float aspectRatio = (float)width() / (float)height();
-    m_camera.setProjectionMatrix(aspectRatio, settings.nearPlane, settings.farPlane, m_renderData.cameraData.heightAngle);
-    update();
+    // Nothing in the history belongs to the new scene
+    m_historyValid = false;
 }
 
 void Realtime::initializeGL() {
@@ -80,10 +190,14 @@ void Realtime::initializeGL() {
 
     m_defaultFBO = defaultFramebufferObject();
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    // Nothing is known about the fresh context yet
+    m_glState.invalidate();
+    m_glState.enable(GL_DEPTH_TEST);
+    m_glState.enable(GL_CULL_FACE);
+
+    // 1. Upload shapes into the geometry arena (grows on demand)
+    m_geometry.init(1 << 16, 1 << 18, m_glState);
 
-    // 1. Create Shape VAOs
     std::vector<PrimitiveType> types = {
         PrimitiveType::PRIMITIVE_CUBE,
         PrimitiveType::PRIMITIVE_SPHERE,
@@ -91,56 +205,22 @@ void Realtime::initializeGL() {
         PrimitiveType::PRIMITIVE_CONE
     };
 
-    for (PrimitiveType t : types) {
-        std::vector<float> data;
-
-        // Initialize the shape with parameters from settings before generating
-        if (t == PrimitiveType::PRIMITIVE_CUBE) {
-            Cube c;
-            c.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-            data = c.generateShape();
-        }
-        else if (t == PrimitiveType::PRIMITIVE_SPHERE) {
-            Sphere s;
-            s.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-            data = s.generateShape();
-        }
-        else if (t == PrimitiveType::PRIMITIVE_CYLINDER) {
-            Cylinder c;
-            c.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-            data = c.generateShape();
-        }
-        else if (t == PrimitiveType::PRIMITIVE_CONE) {
-            Cone c;
-            c.updateParams(settings.shapeParameter1, settings.shapeParameter2);
-            data = c.generateShape();
+    // Tessellate on the job system; only the uploads need this thread
+    std::vector<std::vector<float>> vertices(types.size());
+    std::vector<std::vector<uint32_t>> indices(types.size());
+    JobSystem::get().parallelFor(types.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            // Initialize the shape with parameters from settings before generating
+            std::vector<float> data = generatePrimitiveData(types[i], settings.shapeParameter1, settings.shapeParameter2);
+            buildIndexedMesh(data, vertices[i], indices[i]);
         }
+    });
 
-        if (data.empty()) {
-            std::cerr << "⚠️ WARNING: Shape data is empty for primitive type " << (int)t << std::endl;
+    for (size_t i = 0; i < types.size(); i++) {
+        if (vertices[i].empty()) {
+            std::cerr << "⚠️ WARNING: Shape data is empty for primitive type " << (int)types[i] << std::endl;
         }
-
-        GLuint vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
-
-        // Position (Layout 0)
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-
-        // Normal (Layout 1)
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        m_shapeVAOs[t] = vao;
-        m_shapeVertexCounts[t] = data.size() / 6;
+        m_shapeGeometry[types[i]] = m_geometry.allocate(vertices[i], indices[i], m_glState);
     }
 
     // 2. Initialize Shaders
@@ -160,13 +240,50 @@ void Realtime::initializeGL() {
         "resources/shaders/fullscreen_quad.vert",
         "resources/shaders/composite.frag");
 
+    m_emissiveShader = ShaderLoader::createShaderProgram(
+        "resources/shaders/fullscreen_quad.vert",
+        "resources/shaders/emissiveOnly.frag");
+
+    m_resolveShader = ShaderLoader::createShaderProgram(
+        "resources/shaders/fullscreen_quad.vert",
+        "resources/shaders/temporalResolve.frag");
+
+    // Uniform blocks are fed from the upload ring every frame
+    glUniformBlockBinding(m_gbufferShader, glGetUniformBlockIndex(m_gbufferShader, "FrameData"), FRAME_BLOCK_BINDING);
+    glUniformBlockBinding(m_deferredShader, glGetUniformBlockIndex(m_deferredShader, "FrameData"), FRAME_BLOCK_BINDING);
+    glUniformBlockBinding(m_deferredShader, glGetUniformBlockIndex(m_deferredShader, "LightData"), LIGHT_BLOCK_BINDING);
+    m_uploadRing.init(1 << 20);
+
+    // Matches the 16 ms repaint timer
+    m_dynamicResolution.init(16.f);
+
     // Set samplers for deferred shader once
-    glUseProgram(m_deferredShader);
+    m_glState.useProgram(m_deferredShader);
     glUniform1i(glGetUniformLocation(m_deferredShader, "gPosition"), 0);
     glUniform1i(glGetUniformLocation(m_deferredShader, "gNormal"), 1);
-    glUniform1i(glGetUniformLocation(m_deferredShader, "gAlbedo"), 2);
+    glUniform1i(glGetUniformLocation(m_deferredShader, "gMaterial"), 2);
     glUniform1i(glGetUniformLocation(m_deferredShader, "gEmissive"), 3);
-    glUseProgram(0);
+    glUniform1i(glGetUniformLocation(m_deferredShader, "materials"), MATERIAL_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(m_deferredShader, "halfDiffuse"), HALF_DIFFUSE_TEXTURE_UNIT);
+    m_glState.useProgram(m_gbufferShader);
+    glUniform1i(glGetUniformLocation(m_gbufferShader, "materials"), MATERIAL_TEXTURE_UNIT);
+    m_glState.useProgram(m_emissiveShader);
+    glUniform1i(glGetUniformLocation(m_emissiveShader, "gEmissive"), 3);
+    m_glState.useProgram(m_resolveShader);
+    glUniform1i(glGetUniformLocation(m_resolveShader, "current"), 0);
+    glUniform1i(glGetUniformLocation(m_resolveShader, "motion"), 1);
+    glUniform1i(glGetUniformLocation(m_resolveShader, "history"), 2);
+    m_glState.useProgram(0);
+
+    // Falls back to the per-draw loop in paintGL if unsupported
+    if (m_useIndirect) {
+        m_indirect.init(m_shapeGeometry);
+    }
+
+    // Falls back to lighting everything on the fullscreen quad
+    if (m_useLightVolumes) {
+        m_lightVolumes.init(m_geometry, m_glState);
+    }
 
     // 3. Initialize Fullscreen Quad
     float quadVerts[] = {
@@ -181,7 +298,7 @@ void Realtime::initializeGL() {
 
     glGenVertexArrays(1, &m_quadVAO);
     glGenBuffers(1, &m_quadVBO);
-    glBindVertexArray(m_quadVAO);
+    m_glState.bindVertexArray(m_quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
 
@@ -190,7 +307,7 @@ void Realtime::initializeGL() {
     glEnableVertexAttribArray(1); // UV
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    glBindVertexArray(0);
+    m_glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // 4. Init GBuffer
@@ -198,38 +315,24 @@ void Realtime::initializeGL() {
     int screenH = height() * devicePixelRatio();
     m_gbuffer.init(screenW, screenH);
 
-    // 5. Init Post-Processing FBOs (Lighting & Blur)
-    // --- Lighting FBO ---
-    glGenFramebuffers(1, &m_lightingFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_lightingFBO);
-    glGenTextures(1, &m_lightingTexture);
-    glBindTexture(GL_TEXTURE_2D, m_lightingTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenW, screenH, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_lightingTexture, 0);
-
-    // --- Ping Pong FBOs ---
-    glGenFramebuffers(2, m_pingpongFBO);
-    glGenTextures(2, m_pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, m_pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenW, screenH, 0, GL_RGB, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_pingpongColorbuffers[i], 0);
+    // Temporal history, at output resolution; filtered when reprojected
+    for (RenderTargetHandle &history : m_historyTargets) {
+        history = m_renderTargets.acquire(HDR_FORMAT, screenW, screenH);
     }
+    m_historyValid = false;
+    // Lit scene and bloom, kept for frames that skip their passes
+    m_litTarget = m_renderTargets.acquire(HDR_FORMAT, screenW, screenH);
+    m_bloomTarget = m_renderTargets.acquire(HDR_FORMAT, screenW, screenH);
+    m_passCache.invalidate();
 
     // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_glState.bindFramebuffer(0);
 
     m_elapsedTimer.start();
     m_timer = startTimer(16);
+
+    // The render thread may borrow the context from now on
+    m_glReady = true;
 }
 
 // void Realtime::initializeGL() {
@@ -355,31 +458,26 @@ void Realtime::initializeGL() {
 
 
 void Realtime::resizeGL(int w, int h) {
+    QMutexLocker lock(&m_renderMutex);
     int w_dpi = w * devicePixelRatio();
     int h_dpi = h * devicePixelRatio();
 
-    glViewport(0, 0, w, h);
-
-    // Resize G-Buffer
-    m_gbuffer.resize(w_dpi, h_dpi);
+    // Qt may have recreated and bound its own FBO before calling us
+    m_glState.invalidateFramebuffer();
+    m_glState.viewport(0, 0, w, h);
 
-    // Resize Post-Process Textures
-    glBindTexture(GL_TEXTURE_2D, m_lightingTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w_dpi, h_dpi, 0, GL_RGB, GL_FLOAT, NULL);
-
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, m_pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w_dpi, h_dpi, 0, GL_RGB, GL_FLOAT, NULL);
-    }
+    // Free within a pool bucket; the graph's targets follow the G-buffer
+    resizeFrameTargets(w_dpi, h_dpi);
 
     // Update Camera
     float aspectRatio = (float)w / (float)h;
     m_camera.setProjectionMatrix(
         aspectRatio,
-        settings.nearPlane,
-        settings.farPlane,
+        m_snapshot.settings->nearPlane,
+        m_snapshot.settings->farPlane,
         m_renderData.cameraData.heightAngle
         );
+    m_framePipeline.invalidate();
 }
 
 // void Realtime::resizeGL(int w, int h) {
@@ -396,134 +494,589 @@ void Realtime::resizeGL(int w, int h) {
 // }
 
 
+void Realtime::resizeFrameTargets(int width, int height) {
+    m_gbuffer.resize(width, height);
+    for (RenderTargetHandle &history : m_historyTargets) {
+        history = m_renderTargets.resize(history, width, height);
+    }
+    m_litTarget = m_renderTargets.resize(m_litTarget, width, height);
+    m_bloomTarget = m_renderTargets.resize(m_bloomTarget, width, height);
+    m_historyValid = false;
+    m_passCache.invalidate();
+}
+
+// Frames are drawn by renderFrame on the render thread; Qt's own paint
+// path must not touch the context
+void Realtime::paintEvent(QPaintEvent*) {
+}
+
 void Realtime::paintGL() {
+}
+
+void Realtime::requestFrame() {
+    // At most one request in flight; the render thread catches up on
+    // everything that changed in between when it gets to it
+    if (m_frameRequested.exchange(true)) return;
+    QMetaObject::invokeMethod(&m_renderWorker, [this] { renderFrame(); }, Qt::QueuedConnection);
+}
+
+void Realtime::renderFrame() {
+    m_frameRequested = false;
+    if (m_exiting || !m_glReady) return;
+
+    // Catch up on input and published state, and only go on if something
+    // changed; otherwise the widget keeps presenting its last frame
+    {
+        QMutexLocker lock(&m_renderMutex);
+        drainInput();
+        RenderSnapshot latest = m_snapshots.latest();
+        if (latest.sceneGeneration != m_snapshot.sceneGeneration) m_frameScheduler.sceneChanged();
+        if (latest.settingsRevision != m_snapshot.settingsRevision) m_frameScheduler.settingsChanged();
+        m_snapshot = std::move(latest);
+
+        bool wasIdle = m_frameScheduler.isIdle();
+        if (!m_frameScheduler.needsFrame(m_camera.isDirty(), isAnyKeyHeld())) return;
+        // Don't count the idle time as the first frame's movement
+        if (wasIdle) m_elapsedTimer.restart();
+    }
+
+    // Borrow the context: only the GUI thread can hand it over. The wait
+    // wakes up now and then to notice shutdown.
+    QOpenGLContext *ctx = context();
+    m_grabMutex.lock();
+    m_contextGranted = false;
+    QMetaObject::invokeMethod(this, [this] { grabContext(); }, Qt::QueuedConnection);
+    while (!m_contextGranted && !m_exiting) {
+        m_grabCond.wait(&m_grabMutex, 100);
+    }
+    bool granted = m_contextGranted;
+    m_renderMutex.lock();
+    m_grabMutex.unlock();
+
+    if (granted && !m_exiting) {
+        // Binds the widget's framebuffer on this thread
+        makeCurrent();
+        applySnapshot();
+        drawFrame();
+        doneCurrent();
+    }
+    if (granted) ctx->moveToThread(qGuiApp->thread());
+    m_renderMutex.unlock();
+
+    // Compose the new frame on the GUI thread
+    if (granted) QMetaObject::invokeMethod(this, [this] { update(); }, Qt::QueuedConnection);
+}
+
+void Realtime::grabContext() {
+    if (m_exiting) return;
+    QMutexLocker renderLock(&m_renderMutex);
+    QMutexLocker grabLock(&m_grabMutex);
+    context()->moveToThread(&m_renderThread);
+    m_contextGranted = true;
+    m_grabCond.wakeAll();
+}
+
+void Realtime::stopRenderThread() {
+    if (!m_renderThread.isRunning()) return;
+    m_exiting = true;
+    {
+        QMutexLocker lock(&m_grabMutex);
+        m_grabCond.wakeAll();
+    }
+    m_renderThread.quit();
+    m_renderThread.wait();
+}
+
+void Realtime::drainInput() {
+    InputEvent event;
+    while (m_inputQueue.pop(event)) {
+        applyInput(event);
+    }
+}
+
+void Realtime::drawFrame() {
+    // Transient frame data (pass lists, callbacks) comes from the frame
+    // arenas; last frame's is dead by now
+    FrameArena::beginFrame();
+    uint64_t allocationsBefore = AllocationCounter::threadCount();
+
     // Delta time
     float dt = m_elapsedTimer.restart() * 0.001f;
     updateCamera(dt);
+    if (m_camera.isDirty()) m_cameraRevision++;
+
+    // This frame draws the packet culled last frame, while the workers cull
+    // the camera as it is now for the next one. Without a pending packet
+    // (first frame, new scene or projection) one is prepared on the spot.
+    if (!m_framePipeline.hasPending()) {
+        m_framePipeline.prepare(m_camera, m_cameraRevision);
+        m_allocationWarmup = ALLOCATION_WARMUP_FRAMES;
+    }
+    const FramePacket &packet = m_framePipeline.acquire();
+    m_framePipeline.prepare(m_camera, m_cameraRevision);
+    Camera camera = packet.camera;
 
-    int w_dpi = width() * devicePixelRatio();
-    int h_dpi = height() * devicePixelRatio();
+    // Qt binds its own FBO and sets the viewport before calling paintGL
+    m_glState.invalidateFramebuffer();
+    m_glState.resetStats();
+
+    // Compact the geometry arena a few allocations at a time after frees
+    if (m_geometry.isFragmented()) {
+        m_geometry.defragmentStep(8);
+    }
+
+    // Per-frame data: written straight into this frame's region of the ring
+    m_uploadRing.beginFrame();
+    m_dynamicResolution.beginFrame();
+
+    // Declare this frame's passes; the graph orders them, drops the ones
+    // nothing reads and gives transient targets storage only while needed
+    m_renderGraph.reset(m_gbuffer.getWidth(), m_gbuffer.getHeight());
+
+    // Everything up to the composite (or the temporal resolve) renders into
+    // a scaled-down corner of the full-size targets when the GPU is falling
+    // behind, and always well below output size with temporal upsampling
+    float renderScale = m_useDynamicResolution ? m_dynamicResolution.getScale() : 1.f;
+    float sharpness = m_useDynamicResolution ? m_dynamicResolution.getSharpness() : 0.f;
+    if (m_useTemporalUpsampling) {
+        renderScale = std::min(renderScale, TEMPORAL_RENDER_SCALE);
+        sharpness = TEMPORAL_SHARPNESS;
+    }
+    m_renderGraph.setRenderSize((int)std::round(m_gbuffer.getWidth() * renderScale),
+                                (int)std::round(m_gbuffer.getHeight() * renderScale));
+
+    // What the G-buffer depends on, apart from the jitter. Once that has
+    // been stable for a whole jitter cycle the history has converged; the
+    // jitter then stays put and the G-buffer from the last run is reused.
+    const PassCache::Inputs gbufferInputs = {
+        packet.cameraRevision, m_frameScheduler.getSceneGeneration(), m_materials.getRevision(),
+        (uint64_t)m_renderGraph.getRenderWidth(), (uint64_t)m_renderGraph.getRenderHeight(),
+        (uint64_t)m_useTemporalUpsampling};
+    m_stableFrames = m_passCache.isValid("gbuffer", gbufferInputs) ? m_stableFrames + 1 : 0;
+    bool reuseGBuffer = m_stableFrames > (m_useTemporalUpsampling ? JITTER_PHASES : 0);
+
+    // Move the image by a different subpixel offset every frame, so the
+    // history accumulates samples from across each output pixel
+    glm::vec2 jitter(0.f);
+    if (m_useTemporalUpsampling) {
+        if (!reuseGBuffer) m_jitterIndex = (m_jitterIndex + 1) % JITTER_PHASES;
+        glm::vec2 phase(halton(m_jitterIndex + 1, 2), halton(m_jitterIndex + 1, 3));
+        glm::vec2 renderSize(m_renderGraph.getRenderWidth(), m_renderGraph.getRenderHeight());
+        jitter = (phase - 0.5f) * 2.f / renderSize;
+    }
+    camera.setJitter(jitter);
+
+    FrameUniforms frame;
+    frame.view = camera.getViewMatrix();
+    frame.proj = camera.getProjMatrix();
+    frame.camPos = glm::vec4(camera.getPosition(), 1.f);
+    frame.viewProj = camera.getUnjitteredProjMatrix() * frame.view;
+    frame.prevViewProj = m_historyValid ? m_prevViewProj : frame.viewProj;
+    m_prevViewProj = frame.viewProj;
+    GLintptr frameOffset = m_uploadRing.upload(&frame, sizeof(frame));
+    if (frameOffset != UploadRing::INVALID) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, m_uploadRing.getBuffer(), frameOffset, sizeof(frame));
+    }
+
+    // Ambient, directional lights and any unbounded lights go on the quad;
+    // everything else is drawn as a light volume. Both lists were prepared
+    // when the scene was loaded.
+    const LightUniforms &lights = m_lightList.getUniforms();
+    GLintptr lightOffset = m_uploadRing.upload(&lights, sizeof(lights));
+    if (lightOffset != UploadRing::INVALID) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_uploadRing.getBuffer(), lightOffset, sizeof(lights));
+    }
+
+    RGResource gPosition = m_renderGraph.importTexture("gPosition", m_gbuffer.getPositionTex());
+    RGResource gNormal = m_renderGraph.importTexture("gNormal", m_gbuffer.getNormalTex());
+    RGResource gMaterial = m_renderGraph.importTexture("gMaterial", m_gbuffer.getMaterialTex());
+    RGResource gEmissive = m_renderGraph.importTexture("gEmissive", m_gbuffer.getEmissiveTex());
+    RGResource gMotion = m_renderGraph.importTexture("gMotion", m_gbuffer.getMotionTex());
+    RGResource gDepth = m_renderGraph.importTexture("gDepth", m_gbuffer.getDepthTex());
+    RGResource lit = m_renderGraph.importTexture("lit", m_renderTargets.getTexture(m_litTarget));
+    RGResource backbuffer = m_renderGraph.importFramebuffer("backbuffer", defaultFramebufferObject());
 
     // ==========================================
     // PHASE 1: GEOMETRY PASS
     // Render to G-Buffer
     // ==========================================
-    m_gbuffer.bindForWriting();
-    glViewport(0, 0, m_gbuffer.getWidth(), m_gbuffer.getHeight());
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-
-    glUseProgram(m_gbufferShader);
-
-    glUniformMatrix4fv(glGetUniformLocation(m_gbufferShader, "view"), 1, GL_FALSE, &m_camera.getViewMatrix()[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(m_gbufferShader, "proj"), 1, GL_FALSE, &m_camera.getProjMatrix()[0][0]);
+    if (!reuseGBuffer) {
+        m_renderGraph.addPass("gbuffer", {}, {gPosition, gNormal, gMaterial, gEmissive, gMotion, gDepth},
+                              [this, &packet, gbufferInputs](RenderGraph &graph) {
+                                  geometryPass(packet, graph.getRenderWidth(), graph.getRenderHeight());
+                                  m_gbufferGeneration++;
+                                  m_passCache.update("gbuffer", gbufferInputs);
+                              });
+    }
 
-    for (const auto& shape : m_renderData.shapes) {
-        glUniformMatrix4fv(glGetUniformLocation(m_gbufferShader, "model"), 1, GL_FALSE, &shape.ctm[0][0]);
-        glUniform3fv(glGetUniformLocation(m_gbufferShader, "albedo"), 1, &shape.primitive.material.cDiffuse[0]);
-        glUniform3fv(glGetUniformLocation(m_gbufferShader, "emissive"), 1, &shape.primitive.material.cEmissive[0]);
+    // ==========================================
+    // PHASE 2: LIGHTING PASS
+    // Render to an intermediate target sharing the G-buffer's depth-stencil.
+    // With many lights on the quad, their diffuse part is evaluated at half
+    // resolution first and upsampled by the full-resolution pass. Skipped
+    // (with the resolve) while the G-buffer, lights and materials are as
+    // they were the last time it ran.
+    // ==========================================
+    int quadLights = lights.lightCount.x + lights.lightCount.y + lights.lightCount.z;
+    bool halfResDiffuse = m_useHalfResLighting && quadLights >= HALF_RES_MIN_LIGHTS;
+    const PassCache::Inputs lightingInputs = {
+        m_gbufferGeneration, m_lightList.getRevision(), m_materials.getRevision(), (uint64_t)halfResDiffuse};
+    bool reuseLighting = reuseGBuffer && m_passCache.isValid("lighting", lightingInputs);
+
+    RenderGraph::ResourceList lightingReads = {gPosition, gNormal, gMaterial, gEmissive, gDepth};
+    RGResource halfDiffuse = INVALID_RG_RESOURCE;
+    if (halfResDiffuse && !reuseLighting) {
+        halfDiffuse = m_renderGraph.createTexture("halfDiffuse", HDR_FORMAT, RGSize::HALF_RENDER);
+        m_renderGraph.addPass("halfDiffuse", {gPosition, gNormal, gMaterial}, {halfDiffuse},
+                              [this, halfDiffuse](RenderGraph &graph) {
+                                  graph.bindFramebuffer({halfDiffuse});
+                                  halfDiffusePass(glm::ivec2(graph.getRenderWidth(), graph.getRenderHeight()));
+                              });
+        lightingReads.push_back(halfDiffuse);
+    }
+    if (!reuseLighting) {
+        m_renderGraph.addPass("lighting", std::move(lightingReads), {lit},
+                              [this, lit, gDepth, halfDiffuse, lightingInputs](RenderGraph &graph) {
+                                  graph.bindFramebuffer({lit}, gDepth);
+                                  bool useHalf = halfDiffuse != INVALID_RG_RESOURCE;
+                                  lightingPass(useHalf ? graph.getTexture(halfDiffuse) : 0,
+                                               glm::ivec2(graph.getRenderWidth(), graph.getRenderHeight()));
+                                  // Recorded against the G-buffer run it lit
+                                  PassCache::Inputs inputs = lightingInputs;
+                                  inputs[0] = m_gbufferGeneration;
+                                  m_passCache.update("lighting", inputs);
+                              });
+    }
 
-        glBindVertexArray(m_shapeVAOs[shape.primitive.type]);
-        glDrawArrays(GL_TRIANGLES, 0, m_shapeVertexCounts[shape.primitive.type]);
-        glBindVertexArray(0);
+    // ==========================================
+    // PHASE 2.5: TEMPORAL RESOLVE
+    // Reproject last frame's full-size result with the motion vectors, clamp
+    // it to this frame's neighbourhood and blend this frame in. The output
+    // becomes next frame's history.
+    // ==========================================
+    RGResource sceneColor = lit;
+    bool runResolve = m_useTemporalUpsampling && !reuseLighting;
+    if (m_useTemporalUpsampling && reuseLighting) {
+        // Last frame's result is still current
+        sceneColor = m_renderGraph.importTexture(
+            "resolved", m_renderTargets.getTexture(m_historyTargets[m_historyIndex]), RGSize::FRAME);
+    }
+    else if (runResolve) {
+        RGResource history = m_renderGraph.importTexture(
+            "history", m_renderTargets.getTexture(m_historyTargets[m_historyIndex]), RGSize::FRAME);
+        RGResource resolved = m_renderGraph.importTexture(
+            "resolved", m_renderTargets.getTexture(m_historyTargets[1 - m_historyIndex]), RGSize::FRAME);
+        bool historyValid = m_historyValid;
+        m_renderGraph.addPass("resolve", {lit, gMotion, history}, {resolved},
+                              [this, lit, gMotion, history, resolved, jitter, historyValid](RenderGraph &graph) {
+                                  graph.bindFramebuffer({resolved});
+                                  resolvePass(graph.getTexture(lit), graph.getTexture(gMotion),
+                                              graph.getTexture(history), graph.getUVScale(lit),
+                                              graph.getUVScale(resolved), jitter * 0.5f, historyValid);
+                              });
+        sceneColor = resolved;
     }
 
-    glDisable(GL_DEPTH_TEST);
+    // ==========================================
+    // PHASE 3: BLUR PASS (PING-PONG)
+    // Blur the Emissive Texture. Each step writes a new transient; the graph
+    // lets every other one share storage, which gives back the ping-pong.
+    // The last step writes a kept target, reused until the G-buffer changes.
+    // ==========================================
+    const PassCache::Inputs bloomInputs = {m_gbufferGeneration};
+    bool reuseBloom = reuseGBuffer && m_passCache.isValid("bloom", bloomInputs);
+    RGResource bloomResult = m_renderGraph.importTexture("bloom", m_renderTargets.getTexture(m_bloomTarget));
+    RGResource bloom = reuseBloom ? bloomResult : gEmissive;
+    for (int i = 0; i < BLOOM_PASSES && !reuseBloom; i++) {
+        bool last = i == BLOOM_PASSES - 1;
+        RGResource blurred = last ? bloomResult : m_renderGraph.createTexture("bloom", HDR_FORMAT);
+        bool horizontal = i % 2 == 0;
+        m_renderGraph.addPass("blur", {bloom}, {blurred},
+                              [this, bloom, blurred, horizontal, last](RenderGraph &graph) {
+                                  graph.bindFramebuffer({blurred});
+                                  blurPass(graph.getTexture(bloom), horizontal, graph.getUVScale(bloom));
+                                  if (last) m_passCache.update("bloom", {m_gbufferGeneration});
+                              });
+        bloom = blurred;
+    }
 
     // ==========================================
-    // PHASE 2: LIGHTING PASS
-    // Render to Intermediate FBO (m_lightingFBO)
+    // PHASE 4: COMPOSITE + TONE MAPPING
+    // Render to Screen, upscaling (and sharpening) a reduced-resolution
+    // render. Without emissive materials the bloom isn't read, so the graph
+    // culls the whole blur chain.
     // ==========================================
-    glBindFramebuffer(GL_FRAMEBUFFER, m_lightingFBO);
-    glViewport(0, 0, w_dpi, h_dpi);
-    glClear(GL_COLOR_BUFFER_BIT);
+    bool useBloom = m_sceneHasEmissive;
+    RenderGraph::ResourceList compositeReads = {sceneColor};
+    if (useBloom) compositeReads.push_back(bloom);
+    m_renderGraph.addPass("composite", std::move(compositeReads), {backbuffer},
+                          [this, sceneColor, bloom, backbuffer, useBloom, sharpness](RenderGraph &graph) {
+                              graph.bindFramebuffer({backbuffer});
+                              GLuint scene = graph.getTexture(sceneColor);
+                              RGResource bloomSource = useBloom ? bloom : sceneColor;
+                              compositePass(scene, graph.getTexture(bloomSource), useBloom,
+                                            graph.getUVScale(sceneColor), graph.getUVScale(bloomSource),
+                                            sharpness);
+                          });
+
+    m_renderGraph.compile();
+    m_renderGraph.execute();
+
+    // This frame's result is next frame's history
+    if (runResolve) {
+        m_historyIndex = 1 - m_historyIndex;
+    }
+    m_historyValid = m_useTemporalUpsampling;
 
-    glUseProgram(m_deferredShader);
+    // Everything changed so far is on screen now, bar the camera of the
+    // pending packet: one more frame shows that. The jittered history needs
+    // a full cycle of phases after the last change to converge.
+    m_camera.clearDirty();
+    m_frameScheduler.setSettleFrames(m_useTemporalUpsampling ? JITTER_PHASES : 1);
+    m_frameScheduler.frameRendered();
 
-    // Bind G-Buffer Textures
-    glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, m_gbuffer.getPositionTex());
-    glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, m_gbuffer.getNormalTex());
-    glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, m_gbuffer.getAlbedoTex());
-    glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, m_gbuffer.getEmissiveTex());
-
-    glm::vec3 camPos = m_camera.getPosition();
-    glUniform3fv(glGetUniformLocation(m_deferredShader, "camPos"), 1, &camPos[0]);
-
-    int numLights = std::min((int)m_renderData.lights.size(), 8);
-    glUniform1i(glGetUniformLocation(m_deferredShader, "numLights"), numLights);
-    glUniform1f(glGetUniformLocation(m_deferredShader, "k_a"), m_renderData.globalData.ka);
-    glUniform1f(glGetUniformLocation(m_deferredShader, "k_d"), m_renderData.globalData.kd);
-    glUniform1f(glGetUniformLocation(m_deferredShader, "k_s"), m_renderData.globalData.ks);
-
-    for (int i = 0; i < numLights; i++) {
-        std::string base = "lights[" + std::to_string(i) + "]";
-        const auto& light = m_renderData.lights[i];
-
-        glUniform1i(glGetUniformLocation(m_deferredShader, (base + ".type").c_str()), static_cast<int>(light.type));
-        glUniform3fv(glGetUniformLocation(m_deferredShader, (base + ".pos").c_str()), 1, &light.pos[0]);
-        glUniform3fv(glGetUniformLocation(m_deferredShader, (base + ".dir").c_str()), 1, &light.dir[0]);
-        glUniform3fv(glGetUniformLocation(m_deferredShader, (base + ".color").c_str()), 1, &light.color[0]);
-        glUniform3fv(glGetUniformLocation(m_deferredShader, (base + ".atten").c_str()), 1, &light.function[0]);
-        glUniform1f(glGetUniformLocation(m_deferredShader, (base + ".angle").c_str()), light.angle);
-        glUniform1f(glGetUniformLocation(m_deferredShader, (base + ".penumbra").c_str()), light.penumbra);
+    m_dynamicResolution.endFrame();
+
+    m_uploadRing.endFrame();
+    m_renderTargets.endFrame();
+
+    if (AllocationCounter::ENABLED) {
+        uint64_t allocations = AllocationCounter::threadCount() - allocationsBefore;
+        if (m_allocationWarmup > 0) {
+            m_allocationWarmup--;
+        }
+        else if (allocations > 0) {
+            std::cerr << "[Realtime] frame " << m_frameCount << " made " << allocations
+                      << " heap allocations" << std::endl;
+        }
+    }
+
+    // Report how much the state cache saved, roughly every 10 seconds
+    if (++m_frameCount % 600 == 0) {
+        const GLStateStats &stats = m_glState.getStats();
+        std::cout << "[GLState] state calls this frame: issued = " << stats.issued
+                  << ", elided = " << stats.elided << std::endl;
+        std::cout << "[RenderGraph] passes: " << m_renderGraph.getPassCount()
+                  << ", culled: " << m_renderGraph.getCulledCount()
+                  << ", pooled textures: " << m_renderTargets.getTextureCount() << std::endl;
+        std::cout << "[DynamicResolution] GPU " << m_dynamicResolution.getGpuMs() << " ms, scale "
+                  << m_dynamicResolution.getScale() << std::endl;
+        std::cout << "[FrameScheduler] idle ticks skipped: " << m_frameScheduler.getSkippedFrames() << std::endl;
     }
+}
 
-    glBindVertexArray(m_quadVAO);
+void Realtime::geometryPass(const FramePacket &packet, int renderWidth, int renderHeight) {
+    m_gbuffer.bindForWriting();
+    m_glState.viewport(0, 0, renderWidth, renderHeight);
+    m_gbuffer.clear();
+    m_glState.enable(GL_DEPTH_TEST);
+
+    // Read by the G-buffer pass (emissive) and the lighting passes
+    m_materials.bind(m_glState);
+
+    // Tag every covered pixel with its class (see stencilclass.h); the
+    // reference value is set per draw
+    m_glState.enable(GL_STENCIL_TEST);
+    glStencilMask(STENCIL_CLASS_MASK);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+    // One glMultiDrawElementsIndirect for every visible shape if possible
+    bool drawn = m_indirect.isReady() && m_indirect.draw(packet, m_geometry, m_uploadRing, m_glState);
+    if (!drawn) {
+        drawShapesPerDraw(packet);
+    }
+
+    glStencilMask(0xFF);
+    m_glState.disable(GL_DEPTH_TEST);
+}
+
+// Diffuse irradiance of the quad's lights into the bound half-res target;
+// every texel is written, sky ones with zero
+void Realtime::halfDiffusePass(const glm::ivec2 &renderSize) {
+    m_glState.useProgram(m_deferredShader);
+    m_glState.bindTexture(0, m_gbuffer.getPositionTex());
+    m_glState.bindTexture(1, m_gbuffer.getNormalTex());
+    m_glState.bindTexture(2, m_gbuffer.getMaterialTex());
+    m_glState.bindTexture(3, m_gbuffer.getEmissiveTex());
+    glUniform1i(glGetUniformLocation(m_deferredShader, "lightingMode"), LIGHTING_HALF_DIFFUSE);
+    glUniform2i(glGetUniformLocation(m_deferredShader, "renderSize"), renderSize.x, renderSize.y);
+
+    m_glState.bindVertexArray(m_quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+}
 
-    // ==========================================
-    // PHASE 3: BLUR PASS (PING-PONG)
-    // Blur the Emissive Texture
-    // ==========================================
-    bool horizontal = true, first_iteration = true;
-    int amount = 10; // Number of blur passes
-    glUseProgram(m_blurShader);
+// Expects the lighting target (with the G-buffer depth-stencil) to be bound.
+// With a half-res diffuse texture only the remaining terms are evaluated
+// here, and the diffuse is upsampled.
+void Realtime::lightingPass(GLuint halfDiffuse, const glm::ivec2 &renderSize) {
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    for (unsigned int i = 0; i < amount; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_pingpongFBO[horizontal]);
-        glUniform1i(glGetUniformLocation(m_blurShader, "horizontal"), horizontal);
+    m_glState.useProgram(m_deferredShader);
 
-        glActiveTexture(GL_TEXTURE0);
-        // First iteration: read from Emissive G-Buffer. Subsequent: read from other ping-pong.
-        glBindTexture(GL_TEXTURE_2D, first_iteration ? m_gbuffer.getEmissiveTex() : m_pingpongColorbuffers[!horizontal]);
+    // Bind G-Buffer Textures
+    m_glState.bindTexture(0, m_gbuffer.getPositionTex());
+    m_glState.bindTexture(1, m_gbuffer.getNormalTex());
+    m_glState.bindTexture(2, m_gbuffer.getMaterialTex());
+    m_glState.bindTexture(3, m_gbuffer.getEmissiveTex());
+    if (halfDiffuse) {
+        m_glState.bindTexture(HALF_DIFFUSE_TEXTURE_UNIT, halfDiffuse);
+    }
+    glUniform1i(glGetUniformLocation(m_deferredShader, "lightingMode"),
+                halfDiffuse ? LIGHTING_SPECULAR : LIGHTING_FULL);
+    glUniform2i(glGetUniformLocation(m_deferredShader, "renderSize"), renderSize.x, renderSize.y);
+
+    // Sky pixels are skipped entirely (they stay at the clear colour), lit
+    // pixels run the lighting shader, emissive-only pixels just copy emissive
+    m_glState.enable(GL_STENCIL_TEST);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glStencilFunc(GL_EQUAL, STENCIL_LIT, STENCIL_LIT);
+    m_glState.bindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glBindVertexArray(m_quadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    m_glState.useProgram(m_emissiveShader);
+    glStencilFunc(GL_EQUAL, STENCIL_EMISSIVE_ONLY, STENCIL_CLASS_MASK);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    m_glState.disable(GL_STENCIL_TEST);
 
-        horizontal = !horizontal;
-        first_iteration = false;
+    // Point and spot lights, additively, only where their volumes cover geometry
+    if (!m_lightList.getVolumeLights().empty()) {
+        m_lightVolumes.draw(m_lightList.getVolumeLights(), m_geometry, m_uploadRing, m_glState);
     }
-    glBindVertexArray(0);
+}
 
-    // ==========================================
-    // PHASE 4: COMPOSITE + TONE MAPPING
-    // Render to Screen
-    // ==========================================
-    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
-    glViewport(0, 0, w_dpi, h_dpi);
+// Accumulate the jittered, reduced-resolution lit image into the bound
+// full-size history target
+void Realtime::resolvePass(GLuint current, GLuint motion, GLuint history, const glm::vec2 &renderUVScale,
+                           const glm::vec2 &outputUVScale, const glm::vec2 &jitter, bool historyValid) {
+    m_glState.useProgram(m_resolveShader);
+    m_glState.bindTexture(0, current);
+    m_glState.bindTexture(1, motion);
+    m_glState.bindTexture(2, history);
+    glUniform2fv(glGetUniformLocation(m_resolveShader, "renderUVScale"), 1, &renderUVScale[0]);
+    glUniform2fv(glGetUniformLocation(m_resolveShader, "outputUVScale"), 1, &outputUVScale[0]);
+    glUniform2fv(glGetUniformLocation(m_resolveShader, "jitter"), 1, &jitter[0]);
+    glUniform1i(glGetUniformLocation(m_resolveShader, "historyValid"), historyValid);
+
+    m_glState.bindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// One direction of the separable Gaussian into the bound target
+void Realtime::blurPass(GLuint source, bool horizontal, const glm::vec2 &uvScale) {
+    m_glState.useProgram(m_blurShader);
+    glUniform1i(glGetUniformLocation(m_blurShader, "horizontal"), horizontal);
+    glUniform2fv(glGetUniformLocation(m_blurShader, "uvScale"), 1, &uvScale[0]);
+    m_glState.bindTexture(0, source);
+
+    m_glState.bindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// Tone-map the lit scene plus bloom into the bound target, upscaling the
+// rendered sub-rect to the whole viewport
+void Realtime::compositePass(GLuint scene, GLuint bloom, bool useBloom, const glm::vec2 &sceneUVScale,
+                             const glm::vec2 &bloomUVScale, float sharpness) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glUseProgram(m_compositeShader);
+    m_glState.useProgram(m_compositeShader);
 
     // Texture 0: The Lit Scene (from Phase 2)
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_lightingTexture);
+    m_glState.bindTexture(0, scene);
     glUniform1i(glGetUniformLocation(m_compositeShader, "scene"), 0);
 
     // Texture 1: The Blurred Glow (from Phase 3)
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_pingpongColorbuffers[!horizontal]);
+    m_glState.bindTexture(1, bloom);
     glUniform1i(glGetUniformLocation(m_compositeShader, "bloomBlur"), 1);
+    glUniform1i(glGetUniformLocation(m_compositeShader, "useBloom"), useBloom);
+    glUniform2fv(glGetUniformLocation(m_compositeShader, "uvScale"), 1, &sceneUVScale[0]);
+    glUniform2fv(glGetUniformLocation(m_compositeShader, "bloomUVScale"), 1, &bloomUVScale[0]);
+    glUniform1f(glGetUniformLocation(m_compositeShader, "sharpness"), sharpness);
 
     glUniform1f(glGetUniformLocation(m_compositeShader, "exposure"), 1.0f);
 
-    glBindVertexArray(m_quadVAO);
+    m_glState.bindVertexArray(m_quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+}
 
-    glUseProgram(0);
+// Fallback G-buffer submission: one draw per visible static batch, or per
+// visible shape, in the packet's order
+void Realtime::drawShapesPerDraw(const FramePacket &packet) {
+    // view/proj come from the FrameData block bound in paintGL
+    m_glState.useProgram(m_gbufferShader);
+
+    // Every draw below sources from the arena, so the VAO is bound once
+    m_glState.bindVertexArray(m_geometry.getVAO());
+
+    // The only per-draw material state is the table ID
+    GLint materialLoc = glGetUniformLocation(m_gbufferShader, "materialId");
+
+    // Draws come sorted by class, so the reference rarely changes
+    const std::vector<CullObject> &objects = m_framePipeline.getObjects();
+    const RenderShapes &shapes = m_renderData.shapes;
+    unsigned int stencilRef = 0;
+
+    if (m_cullBatches) {
+        // Vertices are already in world space
+        glm::mat4 identity(1.f);
+        glUniformMatrix4fv(glGetUniformLocation(m_gbufferShader, "model"), 1, GL_FALSE, &identity[0][0]);
+    }
+
+    for (const DrawItem &d : packet.draws) {
+        const CullObject &object = objects[d.object];
+        glUniform1ui(materialLoc, object.material);
+        if (object.stencilClass != stencilRef) {
+            stencilRef = object.stencilClass;
+            glStencilFunc(GL_ALWAYS, stencilRef, 0xFF);
+        }
+
+        if (m_cullBatches) {
+            m_geometry.draw(m_staticBatcher.getBatches()[d.object].geometry);
+        }
+        else {
+            uint32_t s = m_cullShapes[d.object];
+            glUniformMatrix4fv(glGetUniformLocation(m_gbufferShader, "model"), 1, GL_FALSE, &shapes.ctms[s][0][0]);
+            m_geometry.draw(m_shapeGeometry.at(shapes.types[s]));
+        }
+    }
+}
+
+void Realtime::updateCullObjects() {
+    std::vector<CullObject> objects;
+    m_cullShapes.clear();
+
+    // Per-draw path with batching: one object per batch, at the batch's
+    // index. Every batch is its own mesh, so there's no geometry to group
+    // draws by.
+    m_cullBatches = m_useStaticBatching && !m_indirect.isReady();
+    if (m_cullBatches) {
+        const std::vector<StaticBatch> &batches = m_staticBatcher.getBatches();
+        for (const StaticBatch &batch : batches) {
+            objects.push_back({batch.boundsMin, batch.boundsMax, batch.stencilClass, batch.materialId, 0});
+        }
+        m_framePipeline.setObjects(std::move(objects));
+        return;
+    }
+
+    // Otherwise one per shape with geometry, in the indirect object table's
+    // order, so the per-draw path can stand in for the indirect one
+    const RenderShapes &shapes = m_renderData.shapes;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        if (m_shapeGeometry.find(shapes.types[s]) == m_shapeGeometry.end()) continue; // meshes have no geometry yet
+        m_cullShapes.push_back((uint32_t)s);
+
+        CullObject o;
+        o.boundsMin = shapes.boundsMin[s];
+        o.boundsMax = shapes.boundsMax[s];
+        o.material = m_materials.getShapeMaterial(s);
+        o.stencilClass = m_materials.getStencilClass(o.material);
+        o.geometry = (uint16_t)shapes.types[s];
+        objects.push_back(o);
+    }
+    if (m_indirect.isReady()) {
+        objects = m_indirect.setScene(m_renderData, m_materials);
+    }
+    m_framePipeline.setObjects(std::move(objects));
 }
 
 // void Realtime::paintGL() {
@@ -630,42 +1183,95 @@ void Realtime::paintGL() {
 // }
 
 void Realtime::timerEvent(QTimerEvent*) {
-    update();
+    // The render thread decides whether anything changed enough to draw
+    requestFrame();
+}
+
+bool Realtime::isAnyKeyHeld() const {
+    for (const auto &[key, down] : m_keyMap) {
+        if (down) return true;
+    }
+    return false;
 }
 
+// Input handlers only queue the event; the render thread applies it
 void Realtime::keyPressEvent(QKeyEvent *event) {
-    m_keyMap[Qt::Key(event->key())] = true;
+    InputEvent input;
+    input.type = InputEvent::KEY_PRESS;
+    input.key = event->key();
+    m_inputQueue.push(input);
 }
 
 void Realtime::keyReleaseEvent(QKeyEvent *event) {
-    m_keyMap[Qt::Key(event->key())] = false;
+    InputEvent input;
+    input.type = InputEvent::KEY_RELEASE;
+    input.key = event->key();
+    m_inputQueue.push(input);
 }
 
 void Realtime::mousePressEvent(QMouseEvent *event) {
-    if (event->buttons().testFlag(Qt::LeftButton)) {
-        m_mouseDown = true;
-        m_prevMousePos = glm::vec2(event->position().x(), event->position().y());
-    }
+    InputEvent input;
+    input.type = InputEvent::MOUSE_PRESS;
+    input.leftButton = event->buttons().testFlag(Qt::LeftButton);
+    input.position = glm::vec2(event->position().x(), event->position().y());
+    m_inputQueue.push(input);
 }
 
 void Realtime::mouseReleaseEvent(QMouseEvent *event) {
-    if (!event->buttons().testFlag(Qt::LeftButton))
-        m_mouseDown = false;
+    InputEvent input;
+    input.type = InputEvent::MOUSE_RELEASE;
+    input.leftButton = event->buttons().testFlag(Qt::LeftButton);
+    m_inputQueue.push(input);
 }
 
 void Realtime::mouseMoveEvent(QMouseEvent *event) {
-    if (!m_mouseDown) return;
+    // Mouse tracking is on; only drags turn the camera
+    if (!event->buttons().testFlag(Qt::LeftButton)) return;
+
+    InputEvent input;
+    input.type = InputEvent::MOUSE_MOVE;
+    input.leftButton = true;
+    input.position = glm::vec2(event->position().x(), event->position().y());
+    m_inputQueue.push(input);
+}
+
+// Render thread
+void Realtime::applyInput(const InputEvent &event) {
+    switch (event.type) {
+    case InputEvent::KEY_PRESS:
+    case InputEvent::KEY_RELEASE:
+        m_keyMap[Qt::Key(event.key)] = event.type == InputEvent::KEY_PRESS;
+        m_frameScheduler.inputActivity();
+        break;
+
+    case InputEvent::MOUSE_PRESS:
+        if (event.leftButton) {
+            m_mouseDown = true;
+            m_prevMousePos = event.position;
+        }
+        m_frameScheduler.inputActivity();
+        break;
+
+    case InputEvent::MOUSE_RELEASE:
+        if (!event.leftButton) m_mouseDown = false;
+        m_frameScheduler.inputActivity();
+        break;
 
-    glm::vec2 cur(event->position().x(), event->position().y());
-    glm::vec2 delta = cur - m_prevMousePos;
-    m_prevMousePos = cur;
+    case InputEvent::MOUSE_MOVE: {
+        if (!m_mouseDown) break;
 
-    const float sensitivity = 0.005f;
-    float yaw   = -delta.x * sensitivity;
-    float pitch = -delta.y * sensitivity;
+        glm::vec2 delta = event.position - m_prevMousePos;
+        m_prevMousePos = event.position;
 
-    if (yaw != 0.f) m_camera.rotateAroundUp(yaw);
-    if (pitch != 0.f) m_camera.rotateAroundRight(pitch);
+        const float sensitivity = 0.005f;
+        float yaw   = -delta.x * sensitivity;
+        float pitch = -delta.y * sensitivity;
+
+        if (yaw != 0.f) m_camera.rotateAroundUp(yaw);
+        if (pitch != 0.f) m_camera.rotateAroundRight(pitch);
+        break;
+    }
+    }
 }
 
 void Realtime::updateCamera(float dt) {
@@ -692,6 +1298,9 @@ void Realtime::updateCamera(float dt) {
 }
 
 void Realtime::saveViewportImage(const std::string &filePath) {
+    // Between frames the context is back on the GUI thread; hold the render
+    // thread off until the snapshot is done
+    QMutexLocker lock(&m_renderMutex);
     makeCurrent();
 
     int fixedWidth = 1024;
@@ -699,10 +1308,10 @@ void Realtime::saveViewportImage(const std::string &filePath) {
 
     GLuint fbo, texture, rbo;
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    m_glState.bindFramebuffer(fbo);
 
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    m_glState.bindTexture(0, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, fixedWidth, fixedHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
 
@@ -716,31 +1325,42 @@ void Realtime::saveViewportImage(const std::string &filePath) {
     int oldH = height() * devicePixelRatio();
 
     // Temporarily resize GBuffer and Camera for snapshot
-    m_gbuffer.resize(fixedWidth, fixedHeight);
+    resizeFrameTargets(fixedWidth, fixedHeight);
     float aspectRatio = (float)fixedWidth / (float)fixedHeight;
-    m_camera.setProjectionMatrix(aspectRatio, settings.nearPlane, settings.farPlane, m_renderData.cameraData.heightAngle);
-
-    // Render to FBO
-    glViewport(0, 0, fixedWidth, fixedHeight);
+    m_camera.setProjectionMatrix(aspectRatio, m_snapshot.settings->nearPlane, m_snapshot.settings->farPlane,
+                                 m_renderData.cameraData.heightAngle);
+    m_framePipeline.invalidate();
+
+    // Render to FBO, always at full resolution
+    bool oldDynamic = m_useDynamicResolution;
+    bool oldTemporal = m_useTemporalUpsampling;
+    m_useDynamicResolution = false;
+    m_useTemporalUpsampling = false;
+    m_glState.viewport(0, 0, fixedWidth, fixedHeight);
     // Bind default FBO momentarily to fool paintGL into rendering to our bound FBO (since paintGL binds m_defaultFBO)
     GLint oldDefault = m_defaultFBO;
     m_defaultFBO = fbo;
 
-    paintGL();
+    drawFrame();
 
     // Read pixels
     std::vector<unsigned char> pixels(fixedWidth * fixedHeight * 3);
     glReadPixels(0, 0, fixedWidth, fixedHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
 
     // Restore state
+    m_useDynamicResolution = oldDynamic;
+    m_useTemporalUpsampling = oldTemporal;
     m_defaultFBO = oldDefault;
-    glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+    m_glState.bindFramebuffer(m_defaultFBO);
+    m_glState.releaseTexture(texture);
     glDeleteTextures(1, &texture);
     glDeleteRenderbuffers(1, &rbo);
     glDeleteFramebuffers(1, &fbo);
 
-    // Revert resize
+    // Revert resize; resizeGL takes the render lock itself
+    lock.unlock();
     resizeGL(width(), height());
+    doneCurrent();
 
     QImage img(pixels.data(), fixedWidth, fixedHeight, QImage::Format_RGB888);
     img.mirrored().save(QString::fromStdString(filePath));
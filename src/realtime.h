@@ -8,15 +8,37 @@
 #include <glm/glm.hpp>
 #include <QOpenGLWidget>
 #include <QElapsedTimer>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
 #include <unordered_map>
 
 #include "utils/sceneparser.h"
 #include "utils/camera.h"
 #include "utils/gbuffer.h"
+#include "utils/rendertargetpool.h"
+#include "utils/rendergraph.h"
+#include "utils/dynamicresolution.h"
+#include "utils/framescheduler.h"
+#include "utils/passcache.h"
+#include "utils/glstate.h"
+#include "utils/geometryarena.h"
+#include "utils/staticbatcher.h"
+#include "utils/indirectrenderer.h"
+#include "utils/uploadring.h"
+#include "utils/lightvolumes.h"
+#include "utils/lightlist.h"
+#include "utils/uniformblocks.h"
+#include "utils/materialtable.h"
+#include "utils/inputqueue.h"
+#include "utils/rendersnapshot.h"
+#include "utils/framepipeline.h"
 
 class Realtime : public QOpenGLWidget {
 public:
     Realtime(QWidget* parent = nullptr);
+    ~Realtime();
     void finish();
     void sceneChanged();
     void settingsChanged();
@@ -26,6 +48,7 @@ protected:
     void initializeGL() override;
     void paintGL() override;
     void resizeGL(int w, int h) override;
+    void paintEvent(QPaintEvent*) override;
 
     void timerEvent(QTimerEvent*) override;
     void keyPressEvent(QKeyEvent*) override;
@@ -50,32 +73,158 @@ private:
 
     std::unordered_map<int, bool> m_keyMap;
 
-    void updateCamera(float deltaTime);
+    // Skips repaint ticks while nothing changes
+    FrameScheduler m_frameScheduler;
+    bool isAnyKeyHeld() const;
+
+    // --- Render thread ---
+    // Frames are drawn on m_renderThread, which borrows the widget's context
+    // for each one (Qt's threaded QOpenGLWidget scheme). The GUI thread only
+    // publishes snapshots and queues input; composition, resizes and
+    // snapshots hold m_renderMutex while they touch the context.
+    void requestFrame();      // GUI thread
+    void renderFrame();       // render thread
+    void grabContext();       // GUI thread, on the render thread's behalf
+    void stopRenderThread();
+    void drainInput();
+    void applyInput(const InputEvent &event);
+    // GL side of a newly published scene or settings; context current
+    void applySnapshot();
+    void drawFrame();
+
+    QThread m_renderThread;
+    QObject m_renderWorker;   // lives on m_renderThread; frame requests queue to it
+    QMutex m_renderMutex;     // held while the context or render state is in use
+    QMutex m_grabMutex;
+    QWaitCondition m_grabCond;
+    bool m_contextGranted = false; // guarded by m_grabMutex
+    std::atomic<bool> m_frameRequested{false};
+    std::atomic<bool> m_exiting{false};
+    std::atomic<bool> m_glReady{false};
+
+    InputQueue m_inputQueue;
+    SnapshotExchange m_snapshots;
+    RenderSnapshot m_snapshot; // what the render thread works from
+    uint64_t m_appliedSceneGeneration = 0;
+    uint64_t m_appliedSettingsRevision = 0;
 
-    // VAOs for shapes
-    std::unordered_map<PrimitiveType, GLuint> m_shapeVAOs;
-    std::unordered_map<PrimitiveType, int> m_shapeVertexCounts;
+    void updateCamera(float deltaTime);
+    // Resize every frame-sized target; their old contents are discarded
+    void resizeFrameTargets(int width, int height);
+    void drawShapesPerDraw(const FramePacket &packet);
+
+    // Frame passes, run by m_renderGraph
+    void geometryPass(const FramePacket &packet, int renderWidth, int renderHeight);
+    void halfDiffusePass(const glm::ivec2 &renderSize);
+    void lightingPass(GLuint halfDiffuse, const glm::ivec2 &renderSize);
+    void resolvePass(GLuint current, GLuint motion, GLuint history, const glm::vec2 &renderUVScale,
+                     const glm::vec2 &outputUVScale, const glm::vec2 &jitter, bool historyValid);
+    void blurPass(GLuint source, bool horizontal, const glm::vec2 &uvScale);
+    void compositePass(GLuint scene, GLuint bloom, bool useBloom, const glm::vec2 &sceneUVScale,
+                       const glm::vec2 &bloomUVScale, float sharpness);
+
+    // All mesh data lives in one vertex/index buffer pair behind one VAO
+    GeometryArena m_geometry;
+    std::unordered_map<PrimitiveType, GeometryHandle> m_shapeGeometry;
+
+    // Scene geometry pre-transformed and merged per material + cell at load
+    StaticBatcher m_staticBatcher;
+    bool m_useStaticBatching = true;
+
+    // Single multi-draw-indirect submission when the context supports it
+    IndirectRenderer m_indirect;
+    bool m_useIndirect = true;
+
+    // Culls and sorts the next frame's draws on worker threads while this
+    // one is submitted. Its objects are those of the draw path in use.
+    FramePipeline m_framePipeline;
+    void updateCullObjects();
+    bool m_cullBatches = false;         // cull objects are static batches
+    std::vector<uint32_t> m_cullShapes; // otherwise the shape of each
+
+    // Per-frame uniform blocks and indirect commands are streamed through here
+    UploadRing m_uploadRing;
+
+    // Scene lights split by type and preprocessed at load
+    LightList m_lightList;
+
+    // Deduplicated scene materials; the G-buffer stores only their IDs
+    MaterialTable m_materials;
+
+    // Point/spot lights drawn as stencil-masked proxy meshes
+    LightVolumes m_lightVolumes;
+    bool m_useLightVolumes = true;
+
+    // Diffuse from the fullscreen pass's lights at half resolution, upsampled
+    // guided by depth and normals, once there are enough of them to pay off
+    bool m_useHalfResLighting = true;
+    static constexpr int HALF_RES_MIN_LIGHTS = 3;
+    // Units past the G-buffer (0-3) and material table (4)
+    static constexpr int HALF_DIFFUSE_TEXTURE_UNIT = 5;
+    // lightingMode values of deferredLighting.frag
+    enum LightingMode { LIGHTING_FULL, LIGHTING_HALF_DIFFUSE, LIGHTING_SPECULAR };
 
     GLuint m_defaultFBO = 2; // Default to 2 for HighDPI displays, updated in init
 
+    // Shadowed GL state; skips redundant binds (must be declared before m_gbuffer)
+    GLState m_glState;
+    int m_frameCount = 0;
+
     // Deferred Rendering
     GLuint m_gbufferShader;  // geometry.vert/frag
     GLuint m_deferredShader; // fullscreen.vert / deferredLighting.frag
+    GLuint m_emissiveShader; // fullscreen.vert / emissiveOnly.frag
 
     // Fullscreen quad
     GLuint m_quadVAO = 0;
     GLuint m_quadVBO = 0;
 
+    // Screen-sized textures, allocated in size buckets (before m_gbuffer)
+    RenderTargetPool m_renderTargets;
+    // Rebuilt every frame; owns the lighting and bloom targets
+    RenderGraph m_renderGraph;
+    static constexpr int BLOOM_PASSES = 10;
+
+    // Render scale picked from GPU timer queries
+    DynamicResolution m_dynamicResolution;
+    bool m_useDynamicResolution = true;
+
+    // Temporal upsampling: render below output size with a per-frame
+    // subpixel jitter, and accumulate into a full-size history
+    GLuint m_resolveShader;  // fullscreen.vert / temporalResolve.frag
+    bool m_useTemporalUpsampling = true;
+    static constexpr float TEMPORAL_RENDER_SCALE = 0.67f;
+    static constexpr int JITTER_PHASES = 16;
+    static constexpr float TEMPORAL_SHARPNESS = 0.2f;
+    RenderTargetHandle m_historyTargets[2] = {INVALID_RENDER_TARGET, INVALID_RENDER_TARGET};
+    int m_historyIndex = 0;     // target holding last frame's result
+    bool m_historyValid = false;
+    int m_jitterIndex = 0;
+    glm::mat4 m_prevViewProj{1.f};
+
+    // Passes whose inputs haven't changed are left out of the frame, and
+    // their last output is read instead (see PassCache)
+    PassCache m_passCache;
+    uint64_t m_cameraRevision = 0;
+    uint64_t m_gbufferGeneration = 0; // G-buffer passes run so far
+    int m_stableFrames = 0;           // frames the G-buffer inputs went unchanged
+
+    // Debug builds check that a steady frame doesn't touch the heap: once a
+    // scene, size or projection change has had this many frames to settle,
+    // any frame that allocates is reported
+    static constexpr int ALLOCATION_WARMUP_FRAMES = 120;
+    int m_allocationWarmup = 0;
+    // Pass outputs kept across frames for that
+    RenderTargetHandle m_litTarget = INVALID_RENDER_TARGET;
+    RenderTargetHandle m_bloomTarget = INVALID_RENDER_TARGET;
+
     GBuffer m_gbuffer;
 
     // Add these
-    GLuint m_pingpongFBO[2];
-    GLuint m_pingpongColorbuffers[2]; // The textures
     GLuint m_blurShader;
     GLuint m_compositeShader; // Mixes scene + bloom
 
-    GLuint m_lightingFBO;
-    GLuint m_lightingTexture;
+    bool m_sceneHasEmissive = true;
 };
 
 // #pragma once
@@ -0,0 +1,38 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+namespace {
+thread_local uint64_t t_allocations = 0;
+}
+
+uint64_t AllocationCounter::threadCount() {
+    return t_allocations;
+}
+
+// Replacing the plain forms is enough: the array and nothrow forms call
+// these, and the aligned forms keep their own malloc-compatible storage
+void *operator new(std::size_t size) {
+    t_allocations++;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#else
+
+uint64_t AllocationCounter::threadCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations made through operator new, per thread. Only
+// compiled into debug builds (without NDEBUG); release builds keep the
+// standard operator new and always report zero.
+namespace AllocationCounter {
+
+constexpr bool ENABLED =
+#ifdef NDEBUG
+    false;
+#else
+    true;
+#endif
+
+// Allocations made by the calling thread so far
+uint64_t threadCount();
+
+}
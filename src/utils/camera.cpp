@@ -41,6 +41,7 @@ void Camera::rebuildView()
 
     // View matrix = rotation * translation
     m_view = rot * trans;
+    m_dirty = true;
 }
 
 
@@ -73,7 +74,23 @@ void Camera::setProjectionMatrix(float aspect,
     P[2][3] = -1.f;
     P[3][2] = D;
 
+    m_unjitteredProj = P;
+
+    // Shift the whole image by the jitter: x_ndc += jitter.x (same for y)
+    P[2][0] = -m_jitter.x;
+    P[2][1] = -m_jitter.y;
     m_proj = P;
+    m_dirty = true;
+}
+
+void Camera::setJitter(const glm::vec2 &ndcOffset)
+{
+    m_jitter = ndcOffset;
+
+    // The jitter changes every frame but isn't a change of view
+    bool dirty = m_dirty;
+    setProjectionMatrix(m_aspect, m_near, m_far, m_fovy);
+    m_dirty = dirty;
 }
 
 void Camera::translate(const glm::vec3 &delta)
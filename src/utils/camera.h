@@ -18,12 +18,22 @@ public:
                              float farPlane,
                              float heightAngle);
 
+    // Subpixel offset (in NDC) applied to the projection, for temporal
+    // upsampling; rebuilds the projection with the stored parameters
+    void setJitter(const glm::vec2 &ndcOffset);
+
     // Getters
     const glm::mat4 &getViewMatrix()  const { return m_view; }
-    const glm::mat4 &getProjMatrix()  const { return m_proj; }
+    const glm::mat4 &getProjMatrix()  const { return m_proj; } // jittered
+    const glm::mat4 &getUnjitteredProjMatrix() const { return m_unjitteredProj; }
     glm::vec3        getPosition()    const { return m_pos;  }
     glm::vec3        getLook()        const { return m_look; }
 
+    // Set whenever the view or projection changes (not by the jitter);
+    // the renderer clears it once a frame has shown the change
+    bool isDirty() const { return m_dirty; }
+    void clearDirty() { m_dirty = false; }
+
 
     // Movement hooks
     void translate(const glm::vec3 &delta);
@@ -45,6 +55,9 @@ private:
     // Matrices
     glm::mat4 m_view{1.f}; //matrix that moves world into camera space
     glm::mat4 m_proj{1.f}; //perspective projection matrix
+    glm::mat4 m_unjitteredProj{1.f};
+    glm::vec2 m_jitter{0.f};
+    bool m_dirty = true;
 
     glm::mat4 m_projMatrix {1.0f};
     float m_nearPlane = 0.1f;
@@ -0,0 +1,96 @@
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+// Smoothing of the measured GPU time (weight of the newest sample)
+constexpr float TIME_SMOOTHING = 0.2f;
+// Shrink only once this fraction over the target
+constexpr float DEADBAND = 0.1f;
+// Largest step per measurement; shrink faster than we grow back
+constexpr float MAX_SHRINK = 0.9f;
+constexpr float MAX_GROW = 1.05f;
+// Grow back only while this far under the target
+constexpr float HEADROOM = 0.85f;
+// Sharpening applied at MIN_SCALE
+constexpr float MAX_SHARPNESS = 0.5f;
+}
+
+void DynamicResolution::init(float targetMs) {
+    m_targetMs = targetMs;
+    m_scale = MAX_SCALE;
+    m_gpuMs = 0.f;
+
+    m_ready = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (!m_ready) {
+        std::cout << "[DynamicResolution] timer queries not available, rendering at full resolution" << std::endl;
+        return;
+    }
+    glGenQueries(QUERY_COUNT, m_queries);
+    for (bool &pending : m_pending) pending = false;
+    m_next = m_oldest = 0;
+}
+
+void DynamicResolution::destroy() {
+    if (m_ready) glDeleteQueries(QUERY_COUNT, m_queries);
+    m_ready = false;
+    m_timing = false;
+}
+
+void DynamicResolution::beginFrame() {
+    if (!m_ready) return;
+
+    // All queries still in flight: skip timing this frame rather than wait
+    m_timing = !m_pending[m_next];
+    if (m_timing) {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    }
+}
+
+void DynamicResolution::endFrame() {
+    if (!m_ready) return;
+
+    if (m_timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_pending[m_next] = true;
+        m_next = (m_next + 1) % QUERY_COUNT;
+        m_timing = false;
+    }
+    readResults();
+}
+
+void DynamicResolution::readResults() {
+    // Results arrive in submission order; stop at the first that isn't ready
+    while (m_pending[m_oldest]) {
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[m_oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(m_queries[m_oldest], GL_QUERY_RESULT, &ns);
+        m_pending[m_oldest] = false;
+        m_oldest = (m_oldest + 1) % QUERY_COUNT;
+
+        updateScale(ns * 1e-6f);
+    }
+}
+
+void DynamicResolution::updateScale(float frameMs) {
+    m_gpuMs = m_gpuMs == 0.f ? frameMs : m_gpuMs + TIME_SMOOTHING * (frameMs - m_gpuMs);
+
+    // Pixel count, and so roughly cost, goes with the square of the scale.
+    // Shrink once over the target, grow back only with headroom to spare.
+    float goal;
+    if (m_gpuMs > m_targetMs * (1.f + DEADBAND)) goal = m_targetMs;
+    else if (m_gpuMs < m_targetMs * HEADROOM) goal = m_targetMs * HEADROOM;
+    else return;
+
+    float step = std::clamp(std::sqrt(goal / m_gpuMs), MAX_SHRINK, MAX_GROW);
+    m_scale = std::clamp(m_scale * step, MIN_SCALE, MAX_SCALE);
+}
+
+float DynamicResolution::getSharpness() const {
+    return MAX_SHARPNESS * (MAX_SCALE - m_scale) / (MAX_SCALE - MIN_SCALE);
+}
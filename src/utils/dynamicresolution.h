@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+
+// Picks the fraction of the output resolution to render at, so the GPU
+// frame time stays near a target. Each frame is bracketed by a
+// GL_TIME_ELAPSED query; results are read back a few frames later, when
+// they're available, so timing never stalls the pipeline. The scale moves
+// by the square root of the time ratio (cost follows pixel count) and is
+// left alone while the smoothed time sits in a band just under the target.
+class DynamicResolution {
+public:
+    static constexpr float MIN_SCALE = 0.5f;
+    static constexpr float MAX_SCALE = 1.f;
+    // Queries in flight before we give up timing a frame
+    static constexpr int QUERY_COUNT = 4;
+
+    void init(float targetMs);
+    void destroy();
+
+    // Bracket all GPU work of a frame
+    void beginFrame();
+    void endFrame();
+
+    float getScale() const { return m_scale; }
+    // Strength of the composite's sharpening: 0 at native resolution
+    float getSharpness() const;
+    float getGpuMs() const { return m_gpuMs; }
+
+private:
+    void readResults();
+    void updateScale(float frameMs);
+
+    GLuint m_queries[QUERY_COUNT] = {0, 0, 0, 0};
+    bool m_pending[QUERY_COUNT] = {false, false, false, false};
+    int m_next = 0;        // query the next frame uses
+    int m_oldest = 0;      // oldest query that may still be pending
+    bool m_timing = false; // a query is open this frame
+
+    float m_targetMs = 16.f;
+    float m_gpuMs = 0.f;   // smoothed
+    float m_scale = MAX_SCALE;
+    bool m_ready = false;
+};
@@ -0,0 +1,67 @@
+#include "framearena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+std::atomic<uint64_t> FrameArena::s_frame{0};
+
+FrameArena &FrameArena::local() {
+    thread_local FrameArena arena;
+    return arena;
+}
+
+FrameArena::~FrameArena() {
+    for (Block &b : m_blocks) {
+        std::free(b.data);
+    }
+}
+
+size_t FrameArena::getCapacity() const {
+    size_t capacity = 0;
+    for (const Block &b : m_blocks) {
+        capacity += b.size;
+    }
+    return capacity;
+}
+
+void FrameArena::rewind() {
+    // Several blocks means last frame overflowed: replace them with one
+    // that holds a whole frame like it
+    if (m_blocks.size() > 1) {
+        size_t capacity = getCapacity();
+        for (Block &b : m_blocks) {
+            std::free(b.data);
+        }
+        m_blocks.clear();
+        m_blocks.push_back({static_cast<unsigned char*>(std::malloc(capacity)), capacity});
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment) {
+    uint64_t frame = s_frame.load(std::memory_order_acquire);
+    if (frame != m_frame) {
+        m_frame = frame;
+        rewind();
+    }
+
+    if (!m_blocks.empty()) {
+        Block &block = m_blocks.back();
+        size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= block.size) {
+            m_offset = offset + bytes;
+            return block.data + offset;
+        }
+        m_used += m_offset;
+    }
+
+    // Out of room: chain another block, at least as big as everything so
+    // far. malloc aligns it for any fundamental type.
+    size_t size = std::max({INITIAL_CAPACITY, getCapacity(), bytes});
+    unsigned char *data = static_cast<unsigned char*>(std::malloc(size));
+    if (!data) throw std::bad_alloc();
+    m_blocks.push_back({data, size});
+    m_offset = bytes;
+    return data;
+}
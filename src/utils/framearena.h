@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that only lives for one frame. Every thread has
+// its own (local()), so allocating never locks. Nothing is freed
+// individually: FrameArena::beginFrame() starts a new frame, and each
+// thread's arena rewinds itself the next time it allocates. If a frame
+// overflowed the arena, the rewind also merges its blocks into one big
+// enough for that frame, so a steady frame allocates from the heap never.
+//
+// Only work that finishes within the frame may use it; anything handed to
+// the next frame (the frame pipeline's packets) keeps ordinary containers.
+class FrameArena {
+public:
+    static constexpr size_t INITIAL_CAPACITY = 256 * 1024;
+
+    // The calling thread's arena
+    static FrameArena &local();
+    // Start a new frame: everything allocated so far, on any thread, may be
+    // reused from here on
+    static void beginFrame() { s_frame.fetch_add(1, std::memory_order_release); }
+
+    FrameArena() = default;
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena &operator=(const FrameArena&) = delete;
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    // Construct a T in the arena; its destructor never runs
+    template <typename T, typename... Args>
+    T *create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "frame arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    size_t getUsedBytes() const { return m_used + m_offset; }
+    size_t getCapacity() const;
+
+private:
+    struct Block {
+        unsigned char *data;
+        size_t size;
+    };
+
+    void rewind();
+
+    static std::atomic<uint64_t> s_frame;
+    uint64_t m_frame = 0;
+
+    std::vector<Block> m_blocks; // the last one is being allocated from
+    size_t m_offset = 0;         // into the last block
+    size_t m_used = 0;           // in the blocks before it
+};
+
+// STL allocator on the allocating thread's frame arena. deallocate() does
+// nothing, so containers may grow (the old storage is simply left behind)
+// but must not outlive the frame.
+template <typename T>
+struct FrameAllocator {
+    using value_type = T;
+
+    FrameAllocator() = default;
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>&) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T*>(FrameArena::local().allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>&) const { return true; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+// A callable kept in the frame arena: std::function for per-frame
+// callbacks, minus the heap allocation for captures that don't fit inline.
+// Captures must be trivially destructible.
+template <typename Signature>
+class FrameFunction;
+
+template <typename R, typename... Args>
+class FrameFunction<R(Args...)> {
+public:
+    FrameFunction() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FrameFunction>>>
+    FrameFunction(F &&fn) {
+        using T = std::decay_t<F>;
+        m_object = FrameArena::local().create<T>(std::forward<F>(fn));
+        m_invoke = [](void *object, Args... args) -> R {
+            return (*static_cast<T*>(object))(std::forward<Args>(args)...);
+        };
+    }
+
+    R operator()(Args... args) const { return m_invoke(m_object, std::forward<Args>(args)...); }
+    explicit operator bool() const { return m_invoke != nullptr; }
+
+private:
+    void *m_object = nullptr;
+    R (*m_invoke)(void*, Args...) = nullptr;
+};
@@ -0,0 +1,146 @@
+#include "framepipeline.h"
+#include "frustum.h"
+#include "stencilclass.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Non-negative floats order the same as their bit patterns
+uint64_t depthBits(float depth) {
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 1; // 31 bits, sign is always clear
+}
+
+}
+
+FramePipeline::FramePipeline() {
+    // Kept here rather than passed as a temporary: parallelFor uses it in
+    // place until the chunks are done
+    m_cullChunks = [this](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            cullChunk(chunk);
+        }
+    };
+}
+
+FramePipeline::~FramePipeline() {
+    JobSystem::get().wait(m_packetDone);
+}
+
+void FramePipeline::setObjects(std::vector<CullObject> objects) {
+    // The workers may still be reading the old ones
+    JobSystem::get().wait(m_packetDone);
+    m_objects = std::move(objects);
+    m_pending = false;
+}
+
+void FramePipeline::invalidate() {
+    JobSystem::get().wait(m_packetDone);
+    m_pending = false;
+}
+
+void FramePipeline::prepare(const Camera &camera, uint64_t cameraRevision) {
+    // The workers only ever write the packet the GL thread isn't reading
+    JobSystem &jobs = JobSystem::get();
+    jobs.wait(m_packetDone);
+    m_writeIndex = 1 - m_writeIndex;
+    FramePacket &packet = m_packets[m_writeIndex];
+    packet.camera = camera;
+    packet.cameraRevision = cameraRevision;
+    packet.draws.clear();
+    packet.litCount = 0;
+    m_pending = true;
+
+    m_viewProj = camera.getUnjitteredProjMatrix() * camera.getViewMatrix();
+
+    size_t chunks = (m_objects.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (chunks == 0) return;
+    m_chunkDraws.resize(chunks);
+    jobs.parallelFor(chunks, 1, m_cullChunks, m_cullDone);
+    jobs.runAfter(m_cullDone, [this] { mergeChunks(); }, &m_packetDone);
+}
+
+const FramePacket &FramePipeline::acquire() {
+    // Helps with the culling if it isn't done yet
+    JobSystem::get().wait(m_packetDone);
+    m_pending = false;
+    return m_packets[m_writeIndex];
+}
+
+void FramePipeline::cullChunk(size_t chunk) {
+    const glm::mat4 &view = m_packets[m_writeIndex].camera.getViewMatrix();
+    std::vector<DrawItem> &draws = m_chunkDraws[chunk];
+    draws.clear();
+
+    size_t begin = chunk * CHUNK_SIZE;
+    size_t end = std::min(begin + CHUNK_SIZE, m_objects.size());
+    for (size_t i = begin; i < end; i++) {
+        const CullObject &o = m_objects[i];
+        if (!isBoxInFrustum(m_viewProj, o.boundsMin, o.boundsMax)) continue;
+
+        // Front to back within a class, for early depth rejection
+        glm::vec3 center = (o.boundsMin + o.boundsMax) * 0.5f;
+        float depth = std::max(0.f, -(view * glm::vec4(center, 1.f)).z);
+        uint64_t emissive = o.stencilClass == STENCIL_LIT ? 0 : 1;
+        uint64_t key = emissive << 63 | depthBits(depth) << 32 | (uint64_t)o.material << 16 | o.geometry;
+        draws.push_back({key, (uint32_t)i});
+    }
+    std::sort(draws.begin(), draws.end(),
+              [](const DrawItem &a, const DrawItem &b) { return a.sortKey < b.sortKey; });
+}
+
+void FramePipeline::mergeChunks() {
+    FramePacket &packet = m_packets[m_writeIndex];
+    JobSystem &jobs = JobSystem::get();
+    auto byKey = [](const DrawItem &a, const DrawItem &b) { return a.sortKey < b.sortKey; };
+
+    // The sorted chunk lists end to end, each one a run
+    size_t chunks = m_chunkDraws.size();
+    m_runStarts.resize(chunks + 1);
+    m_runStarts[0] = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        m_runStarts[chunk + 1] = m_runStarts[chunk] + m_chunkDraws[chunk].size();
+    }
+    size_t total = m_runStarts[chunks];
+    packet.draws.resize(total);
+    m_mergeScratch.resize(total);
+    jobs.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            std::copy(m_chunkDraws[chunk].begin(), m_chunkDraws[chunk].end(),
+                      packet.draws.begin() + m_runStarts[chunk]);
+        }
+    });
+
+    // Merge neighbouring runs pairwise, every pair of a round at once, until
+    // one is left. Merging one at a time into the whole list would copy it
+    // once per chunk.
+    std::vector<DrawItem> *from = &packet.draws;
+    std::vector<DrawItem> *to = &m_mergeScratch;
+    while (m_runStarts.size() > 2) {
+        size_t runs = m_runStarts.size() - 1;
+        size_t pairs = (runs + 1) / 2;
+        jobs.parallelFor(pairs, 1, [&](size_t begin, size_t end) {
+            for (size_t pair = begin; pair < end; pair++) {
+                // A last run without a partner is merged with nothing
+                auto first = from->begin() + m_runStarts[2 * pair];
+                auto middle = from->begin() + m_runStarts[std::min(2 * pair + 1, runs)];
+                auto last = from->begin() + m_runStarts[std::min(2 * pair + 2, runs)];
+                std::merge(first, middle, middle, last, to->begin() + m_runStarts[2 * pair], byKey);
+            }
+        });
+
+        for (size_t pair = 1; pair <= pairs; pair++) {
+            m_runStarts[pair] = m_runStarts[std::min(2 * pair, runs)];
+        }
+        m_runStarts.resize(pairs + 1);
+        std::swap(from, to);
+    }
+    if (from != &packet.draws) packet.draws.swap(m_mergeScratch);
+
+    packet.litCount = std::partition_point(packet.draws.begin(), packet.draws.end(),
+                                           [](const DrawItem &d) { return (d.sortKey >> 63) == 0; }) -
+                      packet.draws.begin();
+}
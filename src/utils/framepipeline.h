@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "camera.h"
+#include "jobsystem.h"
+
+// Something the G-buffer pass may draw: a shape, or a static batch,
+// depending on the submission path
+struct CullObject {
+    glm::vec3 boundsMin; // world space
+    glm::vec3 boundsMax;
+    unsigned int stencilClass; // see stencilclass.h
+    uint16_t material;         // MaterialTable ID
+    uint16_t geometry;         // which mesh, to group draws of the same one
+};
+
+// A visible object and the key it was sorted by: stencil class first, then
+// front to back, then material and mesh
+struct DrawItem {
+    uint64_t sortKey;
+    uint32_t object; // index into the cull objects
+};
+
+// Everything the GL thread needs from the CPU side of a frame
+struct FramePacket {
+    Camera camera; // as it was when the packet was prepared, unjittered
+    uint64_t cameraRevision = 0;
+
+    std::vector<DrawItem> draws;
+    size_t litCount = 0; // draws[0, litCount) are STENCIL_LIT, the rest STENCIL_EMISSIVE_ONLY
+};
+
+// Runs the CPU side of the G-buffer pass (frustum culling and sort-key
+// building) one frame ahead on the job system: while the GL thread submits
+// frame N from one packet, the workers fill the other for frame N+1. The
+// camera of a packet is sampled when it's prepared, so the pipeline adds a
+// frame of input latency in exchange.
+class FramePipeline {
+public:
+    FramePipeline();
+    ~FramePipeline();
+
+    // The objects every packet is culled from, e.g. on a scene load. Drops
+    // the pending packet.
+    void setObjects(std::vector<CullObject> objects);
+    const std::vector<CullObject> &getObjects() const { return m_objects; }
+
+    // Drop the pending packet, e.g. because the projection changed
+    void invalidate();
+    bool hasPending() const { return m_pending; }
+
+    // Stage 1: start culling for this camera and return at once
+    void prepare(const Camera &camera, uint64_t cameraRevision);
+    // Stage 2: wait for the pending packet and hand it over. It stays valid
+    // (and untouched) until the next acquire.
+    const FramePacket &acquire();
+
+private:
+    // Objects per job; enough to outweigh handing the job out
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    void cullChunk(size_t chunk);
+    void mergeChunks();
+
+    std::vector<CullObject> m_objects;
+
+    // Double-buffered: the GL thread reads one while the workers write the other
+    FramePacket m_packets[2];
+    int m_writeIndex = 0; // packet being (or last) prepared
+    bool m_pending = false;
+
+    // Per-chunk results, merged by a job that depends on all of them
+    std::vector<std::vector<DrawItem>> m_chunkDraws;
+    // The merge ping-pongs between the packet's list and this one; runs
+    // still to merge start at m_runStarts (plus the end of the last)
+    std::vector<DrawItem> m_mergeScratch;
+    std::vector<size_t> m_runStarts;
+    std::function<void(size_t, size_t)> m_cullChunks;
+    JobCounter m_cullDone;
+    JobCounter m_packetDone;
+    glm::mat4 m_viewProj{1.f};
+};
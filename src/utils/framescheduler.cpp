@@ -0,0 +1,26 @@
+#include "framescheduler.h"
+
+bool FrameScheduler::needsFrame(bool cameraDirty, bool keysHeld) {
+    bool changed = cameraDirty || keysHeld || m_inputActive ||
+                   m_sceneGeneration != m_renderedSceneGeneration ||
+                   m_settingsRevision != m_renderedSettingsRevision;
+    if (changed) {
+        m_settleRemaining = m_settleFrames;
+    }
+    else if (m_settleRemaining > 0) {
+        m_settleRemaining--;
+    }
+    else {
+        m_idle = true;
+        m_skippedFrames++;
+        return false;
+    }
+    m_idle = false;
+    return true;
+}
+
+void FrameScheduler::frameRendered() {
+    m_renderedSceneGeneration = m_sceneGeneration;
+    m_renderedSettingsRevision = m_settingsRevision;
+    m_inputActive = false;
+}
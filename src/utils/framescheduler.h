@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+// Decides on each repaint tick whether a new frame is needed. Changes are
+// tracked as counters (scene loads, settings edits) compared with the
+// values the last frame was drawn with, plus flags for camera movement and
+// input. Once nothing changes the timer stops scheduling paints and the
+// widget keeps showing its last composited frame.
+class FrameScheduler {
+public:
+    void sceneChanged()    { m_sceneGeneration++; }
+    void settingsChanged() { m_settingsRevision++; }
+    // Key or button pressed or released
+    void inputActivity()   { m_inputActive = true; }
+
+    // Keep drawing this many frames after the last change (e.g. so a
+    // temporal history can converge)
+    void setSettleFrames(int frames) { m_settleFrames = frames; }
+
+    // Called from the timer. cameraDirty and keysHeld are sampled by the
+    // caller: held movement keys move the camera inside paintGL.
+    bool needsFrame(bool cameraDirty, bool keysHeld);
+    // Called once a frame has been drawn: it shows everything up to now
+    void frameRendered();
+
+    // True while the last tick drew nothing
+    bool isIdle() const { return m_idle; }
+
+    uint64_t getSceneGeneration() const { return m_sceneGeneration; }
+    uint64_t getSettingsRevision() const { return m_settingsRevision; }
+    uint64_t getSkippedFrames() const { return m_skippedFrames; }
+
+private:
+    uint64_t m_sceneGeneration = 0;
+    uint64_t m_settingsRevision = 0;
+    uint64_t m_renderedSceneGeneration = ~0ull; // nothing drawn yet
+    uint64_t m_renderedSettingsRevision = ~0ull;
+    bool m_inputActive = false;
+
+    int m_settleFrames = 0;
+    int m_settleRemaining = 0;
+    bool m_idle = false;
+    uint64_t m_skippedFrames = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+// Conservative AABB-vs-frustum test in clip space: the box is rejected only
+// if all 8 corners lie outside the same clip plane of viewProj.
+inline bool isBoxInFrustum(const glm::mat4 &viewProj,
+                           const glm::vec3 &boxMin,
+                           const glm::vec3 &boxMax) {
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 p((i & 1) ? boxMax.x : boxMin.x,
+                    (i & 2) ? boxMax.y : boxMin.y,
+                    (i & 4) ? boxMax.z : boxMin.z);
+        corners[i] = viewProj * glm::vec4(p, 1.f);
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        bool allBelow = true, allAbove = true;
+        for (const glm::vec4 &c : corners) {
+            if (c[axis] >= -c.w) allBelow = false;
+            if (c[axis] <=  c.w) allAbove = false;
+        }
+        if (allBelow || allAbove) return false;
+    }
+    return true;
+}
+
+// World-space bounds of the unit primitive box [-0.5, 0.5]^3 under ctm
+inline void transformUnitBounds(const glm::mat4 &ctm, glm::vec3 &outMin, glm::vec3 &outMax) {
+    outMin = glm::vec3( INFINITY);
+    outMax = glm::vec3(-INFINITY);
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 p(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f, 1.f);
+        glm::vec3 w = glm::vec3(ctm * p);
+        outMin = glm::min(outMin, w);
+        outMax = glm::max(outMax, w);
+    }
+}
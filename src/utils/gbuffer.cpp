@@ -1,7 +1,30 @@
 #include "gbuffer.h"
 #include <iostream>
 
-GBuffer::GBuffer() {
+namespace {
+const RenderTargetFormat FORMATS[] = {
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_NEAREST},                            // Position (High Precision)
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_NEAREST},                            // Normal (High Precision)
+    {GL_R16UI, GL_RED_INTEGER, GL_UNSIGNED_SHORT, GL_NEAREST},              // Material ID (never filtered)
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_NEAREST},                            // Emissive
+    {GL_RG16F, GL_RG, GL_FLOAT, GL_NEAREST},                                // Motion vectors (temporal resolve)
+    {GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_NEAREST} // Packed depth + stencil; the lighting pass attaches it too
+};
+
+const GLenum ATTACHMENTS[] = {
+    GL_COLOR_ATTACHMENT0,
+    GL_COLOR_ATTACHMENT1,
+    GL_COLOR_ATTACHMENT2,
+    GL_COLOR_ATTACHMENT3,
+    GL_COLOR_ATTACHMENT4,
+    GL_DEPTH_STENCIL_ATTACHMENT
+};
+}
+
+GBuffer::GBuffer(GLState &glState, RenderTargetPool &pool)
+    : m_glState(glState),
+      m_pool(pool)
+{
 }
 
 GBuffer::~GBuffer() {
@@ -15,20 +38,16 @@ void GBuffer::init(int width, int height) {
 
     // 2. Create the Framebuffer
     glGenFramebuffers(1, &m_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    m_glState.bindFramebuffer(m_fbo);
 
-    // 3. Create and Attach Textures
-    createTextures(width, height);
-    createDepth(width, height);
+    // 3. Take the textures from the pool and attach them
+    for (int i = 0; i < TARGET_COUNT; i++) {
+        m_targets[i] = m_pool.acquire(FORMATS[i], width, height);
+    }
+    attachTargets();
 
-    // 4. Tell OpenGL we will draw to these 4 attachments
-    GLenum attachments[4] = {
-        GL_COLOR_ATTACHMENT0, // Position
-        GL_COLOR_ATTACHMENT1, // Normal
-        GL_COLOR_ATTACHMENT2, // Albedo
-        GL_COLOR_ATTACHMENT3  // Emissive
-    };
-    glDrawBuffers(4, attachments);
+    // 4. Tell OpenGL we will draw to all 5 color attachments
+    glDrawBuffers(DEPTH, ATTACHMENTS);
 
     // 5. Verify Completeness
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -37,7 +56,7 @@ void GBuffer::init(int width, int height) {
     }
 
     // 6. Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_glState.bindFramebuffer(0);
 }
 
 void GBuffer::resize(int width, int height) {
@@ -45,86 +64,55 @@ void GBuffer::resize(int width, int height) {
     if (m_width == width && m_height == height) return;
     if (width <= 0 || height <= 0) return;
 
-    // Full cleanup and re-initialization
-    destroy();
-    init(width, height);
+    m_width = width;
+    m_height = height;
+    for (int i = 0; i < TARGET_COUNT; i++) {
+        m_targets[i] = m_pool.resize(m_targets[i], width, height);
+    }
+
+    m_glState.bindFramebuffer(m_fbo);
+    attachTargets();
+    m_glState.bindFramebuffer(0);
 }
 
 void GBuffer::destroy() {
     if (m_fbo) {
+        m_glState.releaseFramebuffer(m_fbo);
         glDeleteFramebuffers(1, &m_fbo);
         m_fbo = 0;
     }
-    if (m_positionTex) {
-        glDeleteTextures(1, &m_positionTex);
-        m_positionTex = 0;
-    }
-    if (m_normalTex) {
-        glDeleteTextures(1, &m_normalTex);
-        m_normalTex = 0;
-    }
-    if (m_albedoTex) {
-        glDeleteTextures(1, &m_albedoTex);
-        m_albedoTex = 0;
-    }
-    if (m_emissiveTex) {
-        glDeleteTextures(1, &m_emissiveTex);
-        m_emissiveTex = 0;
-    }
-    if (m_depthTex) {
-        glDeleteTextures(1, &m_depthTex);
-        m_depthTex = 0;
+    for (int i = 0; i < TARGET_COUNT; i++) {
+        m_pool.release(m_targets[i]);
+        m_targets[i] = INVALID_RENDER_TARGET;
+        m_attached[i] = 0;
     }
 }
 
 void GBuffer::bindForWriting() {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    m_glState.bindFramebuffer(m_fbo);
 }
 
-void GBuffer::createTextures(int width, int height) {
-    // --- Position (High Precision) ---
-    glGenTextures(1, &m_positionTex);
-    glBindTexture(GL_TEXTURE_2D, m_positionTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_positionTex, 0);
-
-    // --- Normal (High Precision) ---
-    glGenTextures(1, &m_normalTex);
-    glBindTexture(GL_TEXTURE_2D, m_normalTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normalTex, 0);
-
-    // --- Albedo (Standard Precision is usually fine, but 16F is safer for math) ---
-    glGenTextures(1, &m_albedoTex);
-    glBindTexture(GL_TEXTURE_2D, m_albedoTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_albedoTex, 0);
-
-    // --- Emissive ---
-    glGenTextures(1, &m_emissiveTex);
-    glBindTexture(GL_TEXTURE_2D, m_emissiveTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, m_emissiveTex, 0);
+void GBuffer::clear() {
+    const GLfloat zero[4] = {0.f, 0.f, 0.f, 0.f};
+    const GLuint noMaterial[4] = {0, 0, 0, 0};
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    glClearBufferuiv(GL_COLOR, 2, noMaterial);
+    glClearBufferfv(GL_COLOR, 3, zero);
+    glClearBufferfv(GL_COLOR, 4, zero); // sky: no motion
+    glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.f, 0);
 }
 
-void GBuffer::createDepth(int width, int height) {
-    glGenTextures(1, &m_depthTex);
-    glBindTexture(GL_TEXTURE_2D, m_depthTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+GLuint GBuffer::getTexture(Target target) const {
+    return m_targets[target] == INVALID_RENDER_TARGET ? 0 : m_pool.getTexture(m_targets[target]);
+}
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTex, 0);
+void GBuffer::attachTargets() {
+    // The FBO must be bound; attachments whose storage didn't change are skipped
+    for (int i = 0; i < TARGET_COUNT; i++) {
+        GLuint texture = m_pool.getTexture(m_targets[i]);
+        if (texture == m_attached[i]) continue;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, ATTACHMENTS[i], GL_TEXTURE_2D, texture, 0);
+        m_attached[i] = texture;
+    }
 }
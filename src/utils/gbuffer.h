@@ -5,36 +5,49 @@
 #endif
 #include <GL/glew.h>
 
+#include "glstate.h"
+#include "rendertargetpool.h"
+
 class GBuffer {
 public:
-    GBuffer();
+    GBuffer(GLState &glState, RenderTargetPool &pool);
     ~GBuffer();
 
     void init(int width, int height);
+    // Cheap within a pool bucket: only the attachments that changed storage
+    // are re-attached
     void resize(int width, int height);
     void bindForWriting();
+    // Clear every target, depth and stencil; the material ID target is an
+    // integer format, which glClear can't be used on
+    void clear();
 
     // Getters for textures
-    GLuint getPositionTex() const { return m_positionTex; }
-    GLuint getNormalTex()   const { return m_normalTex; }
-    GLuint getAlbedoTex()   const { return m_albedoTex; }
-    GLuint getEmissiveTex() const { return m_emissiveTex; }
-    GLuint getDepthTex()    const { return m_depthTex; }
+    GLuint getPositionTex() const { return getTexture(POSITION); }
+    GLuint getNormalTex()   const { return getTexture(NORMAL); }
+    GLuint getMaterialTex() const { return getTexture(MATERIAL); } // R16UI, see MaterialTable
+    GLuint getEmissiveTex() const { return getTexture(EMISSIVE); }
+    GLuint getMotionTex()   const { return getTexture(MOTION); }   // RG16F uv offset since last frame
+    GLuint getDepthTex()    const { return getTexture(DEPTH); } // depth24 + stencil8
 
     int getWidth() const { return m_width; }
     int getHeight() const { return m_height; }
 
 private:
-    void createTextures(int width, int height);
-    void createDepth(int width, int height);
+    enum Target { POSITION, NORMAL, MATERIAL, EMISSIVE, MOTION, DEPTH, TARGET_COUNT };
+
+    GLuint getTexture(Target target) const;
+    void attachTargets();
     void destroy(); // Helper to clean up
 
+    GLState &m_glState;
+    RenderTargetPool &m_pool;
+
     GLuint m_fbo = 0;
-    GLuint m_positionTex = 0;
-    GLuint m_normalTex   = 0;
-    GLuint m_albedoTex   = 0;
-    GLuint m_emissiveTex = 0;
-    GLuint m_depthTex    = 0;
+    RenderTargetHandle m_targets[TARGET_COUNT] = {INVALID_RENDER_TARGET, INVALID_RENDER_TARGET,
+                                                  INVALID_RENDER_TARGET, INVALID_RENDER_TARGET,
+                                                  INVALID_RENDER_TARGET, INVALID_RENDER_TARGET};
+    GLuint m_attached[TARGET_COUNT] = {0, 0, 0, 0, 0, 0}; // textures currently on the FBO
 
     int m_width = 0;
     int m_height = 0;
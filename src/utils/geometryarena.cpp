@@ -0,0 +1,239 @@
+#include "geometryarena.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+constexpr size_t VERTEX_BYTES = GeometryArena::FLOATS_PER_VERTEX * sizeof(float);
+constexpr size_t INDEX_BYTES = sizeof(uint32_t);
+}
+
+void GeometryArena::init(uint32_t vertexCapacity, uint32_t indexCapacity, GLState &glState) {
+    m_vertexAlloc.reset(vertexCapacity);
+    m_indexAlloc.reset(indexCapacity);
+
+    glGenVertexArrays(1, &m_vao);
+    glState.bindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity * VERTEX_BYTES, nullptr, GL_STATIC_DRAW);
+
+    // Position (Layout 0)
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)0);
+    // Normal (Layout 1)
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(3 * sizeof(float)));
+
+    // The element buffer binding is VAO state
+    glGenBuffers(1, &m_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * INDEX_BYTES, nullptr, GL_STATIC_DRAW);
+
+    glState.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::destroy(GLState &glState) {
+    if (m_vao) {
+        glState.releaseVertexArray(m_vao);
+        glDeleteVertexArrays(1, &m_vao);
+        m_vao = 0;
+    }
+    GLuint buffers[2] = {m_vbo, m_ibo};
+    glDeleteBuffers(2, buffers);
+    m_vbo = m_ibo = 0;
+
+    m_slots.clear();
+    m_alive.clear();
+    m_freeSlots.clear();
+    m_vertexAlloc.reset(0);
+    m_indexAlloc.reset(0);
+    m_fragmented = false;
+    m_passActive = false;
+}
+
+GeometryHandle GeometryArena::allocate(const std::vector<float> &vertices,
+                                       const std::vector<uint32_t> &indices,
+                                       GLState &glState) {
+    uint32_t vertexCount = vertices.size() / FLOATS_PER_VERTEX;
+    uint32_t indexCount = indices.size();
+    if (vertexCount == 0 || indexCount == 0) return INVALID_GEOMETRY;
+
+    uint32_t vOffset = m_vertexAlloc.allocate(vertexCount);
+    if (vOffset == OffsetAllocator::INVALID) {
+        growVertices(m_vertexAlloc.getCapacity() + vertexCount, glState);
+        vOffset = m_vertexAlloc.allocate(vertexCount);
+    }
+    uint32_t iOffset = m_indexAlloc.allocate(indexCount);
+    if (iOffset == OffsetAllocator::INVALID) {
+        growIndices(m_indexAlloc.getCapacity() + indexCount, glState);
+        iOffset = m_indexAlloc.allocate(indexCount);
+    }
+
+    // Upload through the copy target so the bound VAO is left alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vOffset * VERTEX_BYTES, vertexCount * VERTEX_BYTES, vertices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, iOffset * INDEX_BYTES, indexCount * INDEX_BYTES, indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GeometryRange range;
+    range.baseVertex = (GLint)vOffset;
+    range.vertexCount = vertexCount;
+    range.firstIndex = iOffset;
+    range.indexCount = indexCount;
+
+    GeometryHandle handle;
+    if (!m_freeSlots.empty()) {
+        handle = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        m_slots[handle] = range;
+        m_alive[handle] = true;
+    }
+    else {
+        handle = m_slots.size();
+        m_slots.push_back(range);
+        m_alive.push_back(true);
+    }
+    return handle;
+}
+
+void GeometryArena::free(GeometryHandle handle) {
+    if (handle == INVALID_GEOMETRY || handle >= m_slots.size() || !m_alive[handle]) return;
+
+    const GeometryRange &range = m_slots[handle];
+    m_vertexAlloc.free(range.baseVertex, range.vertexCount);
+    m_indexAlloc.free(range.firstIndex, range.indexCount);
+
+    m_alive[handle] = false;
+    m_freeSlots.push_back(handle);
+    m_fragmented = true;
+    // The pass's lists may hold the handle; start over with the new hole
+    m_passActive = false;
+}
+
+void GeometryArena::draw(GeometryHandle handle) const {
+    const GeometryRange &range = m_slots[handle];
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                             (void*)(range.firstIndex * INDEX_BYTES), range.baseVertex);
+}
+
+void GeometryArena::beginDefragmentPass() {
+    // Highest allocations first: they have the most room to move down
+    m_vertexOrder.clear();
+    for (GeometryHandle h = 0; h < m_slots.size(); h++) {
+        if (m_alive[h]) m_vertexOrder.push_back(h);
+    }
+    m_indexOrder = m_vertexOrder;
+    std::sort(m_vertexOrder.begin(), m_vertexOrder.end(), [this](GeometryHandle a, GeometryHandle b) {
+        return m_slots[a].baseVertex > m_slots[b].baseVertex;
+    });
+    std::sort(m_indexOrder.begin(), m_indexOrder.end(), [this](GeometryHandle a, GeometryHandle b) {
+        return m_slots[a].firstIndex > m_slots[b].firstIndex;
+    });
+
+    m_vertexCursor = 0;
+    m_indexCursor = 0;
+    m_passMoves = 0;
+    m_passActive = true;
+}
+
+// Destination always ends before the source starts, so the copy within one
+// buffer never overlaps
+bool GeometryArena::moveVertices(GeometryRange &range) {
+    uint32_t v = m_vertexAlloc.allocateBelow(range.vertexCount, range.baseVertex);
+    if (v == OffsetAllocator::INVALID) return false;
+    glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        range.baseVertex * VERTEX_BYTES, v * VERTEX_BYTES, range.vertexCount * VERTEX_BYTES);
+    m_vertexAlloc.free(range.baseVertex, range.vertexCount);
+    range.baseVertex = (GLint)v;
+    return true;
+}
+
+bool GeometryArena::moveIndices(GeometryRange &range) {
+    uint32_t i = m_indexAlloc.allocateBelow(range.indexCount, range.firstIndex);
+    if (i == OffsetAllocator::INVALID) return false;
+    glBindBuffer(GL_COPY_READ_BUFFER, m_ibo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        range.firstIndex * INDEX_BYTES, i * INDEX_BYTES, range.indexCount * INDEX_BYTES);
+    m_indexAlloc.free(range.firstIndex, range.indexCount);
+    range.firstIndex = i;
+    return true;
+}
+
+bool GeometryArena::defragmentStep(int maxMoves) {
+    if (!m_fragmented) return false;
+
+    // A pass tries every allocation once, over as many calls as it takes.
+    // Allocations made meanwhile wait for the next pass.
+    if (!m_passActive) beginDefragmentPass();
+
+    int moves = 0;
+    while (moves < maxMoves && m_vertexCursor < m_vertexOrder.size()) {
+        if (moveVertices(m_slots[m_vertexOrder[m_vertexCursor++]])) moves++;
+    }
+    while (moves < maxMoves && m_indexCursor < m_indexOrder.size()) {
+        if (moveIndices(m_slots[m_indexOrder[m_indexCursor++]])) moves++;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_passMoves += moves;
+
+    if (m_vertexCursor == m_vertexOrder.size() && m_indexCursor == m_indexOrder.size()) {
+        // A pass that moved nothing means everything is as low as it can go;
+        // otherwise the moves may have opened new holes for another
+        m_passActive = false;
+        if (m_passMoves == 0) m_fragmented = false;
+    }
+    return m_fragmented;
+}
+
+// Allocate a bigger buffer and copy the old contents over on the GPU
+GLuint GeometryArena::resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes) {
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+
+    if (oldBytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    return newBuffer;
+}
+
+void GeometryArena::growVertices(uint32_t minCapacity, GLState &glState) {
+    uint32_t oldCapacity = m_vertexAlloc.getCapacity();
+    uint32_t newCapacity = std::max(minCapacity, oldCapacity * 2);
+    m_vbo = resizeBuffer(m_vbo, oldCapacity * VERTEX_BYTES, newCapacity * VERTEX_BYTES);
+    m_vertexAlloc.grow(newCapacity);
+
+    // Re-point the attributes at the new buffer
+    glState.bindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::cout << "[GeometryArena] grew vertex buffer to " << newCapacity << " vertices" << std::endl;
+}
+
+void GeometryArena::growIndices(uint32_t minCapacity, GLState &glState) {
+    uint32_t oldCapacity = m_indexAlloc.getCapacity();
+    uint32_t newCapacity = std::max(minCapacity, oldCapacity * 2);
+    m_ibo = resizeBuffer(m_ibo, oldCapacity * INDEX_BYTES, newCapacity * INDEX_BYTES);
+    m_indexAlloc.grow(newCapacity);
+
+    glState.bindVertexArray(m_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+
+    std::cout << "[GeometryArena] grew index buffer to " << newCapacity << " indices" << std::endl;
+}
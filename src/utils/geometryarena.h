@@ -0,0 +1,85 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "glstate.h"
+#include "offsetallocator.h"
+
+// Stable reference to an allocation; survives growth and defragmentation
+using GeometryHandle = uint32_t;
+constexpr GeometryHandle INVALID_GEOMETRY = ~0u;
+
+// Where an allocation currently lives inside the arena
+struct GeometryRange {
+    GLint  baseVertex = 0;
+    GLuint vertexCount = 0;
+    GLuint firstIndex = 0;
+    GLuint indexCount = 0;
+};
+
+// All mesh data in one vertex buffer and one index buffer behind a single
+// VAO (interleaved position + normal, 32-bit indices relative to the
+// allocation). Draws select their data with firstIndex/baseVertex, so
+// switching meshes never switches VAOs.
+class GeometryArena {
+public:
+    static constexpr int FLOATS_PER_VERTEX = 6;
+
+    void init(uint32_t vertexCapacity, uint32_t indexCapacity, GLState &glState);
+    void destroy(GLState &glState);
+
+    // Copy a mesh into the arena, growing the buffers if needed
+    GeometryHandle allocate(const std::vector<float> &vertices,
+                            const std::vector<uint32_t> &indices,
+                            GLState &glState);
+    void free(GeometryHandle handle);
+
+    const GeometryRange &get(GeometryHandle handle) const { return m_slots[handle]; }
+    GLuint getVAO() const { return m_vao; }
+
+    // Issue the draw for one allocation; the arena VAO must be bound
+    void draw(GeometryHandle handle) const;
+
+    // Move up to maxMoves allocations into holes closer to the start of the
+    // buffers. Cheap to call every frame; returns true while work remains.
+    bool defragmentStep(int maxMoves);
+    bool isFragmented() const { return m_fragmented; }
+
+private:
+    void growVertices(uint32_t minCapacity, GLState &glState);
+    void growIndices(uint32_t minCapacity, GLState &glState);
+    GLuint resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes);
+    void beginDefragmentPass();
+    bool moveVertices(GeometryRange &range);
+    bool moveIndices(GeometryRange &range);
+
+    GLuint m_vao = 0;
+    GLuint m_vbo = 0;
+    GLuint m_ibo = 0;
+
+    OffsetAllocator m_vertexAlloc; // in vertices
+    OffsetAllocator m_indexAlloc;  // in indices
+
+    std::vector<GeometryRange> m_slots;
+    std::vector<bool> m_alive;
+    std::vector<GeometryHandle> m_freeSlots;
+
+    bool m_fragmented = false;
+
+    // The current defragmentation pass: the live allocations, highest
+    // first, separately by vertex and index offset, and how far each list
+    // has been worked through. Kept across calls, and their storage across
+    // passes.
+    bool m_passActive = false;
+    int m_passMoves = 0;
+    std::vector<GeometryHandle> m_vertexOrder;
+    std::vector<GeometryHandle> m_indexOrder;
+    size_t m_vertexCursor = 0;
+    size_t m_indexCursor = 0;
+};
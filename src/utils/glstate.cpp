@@ -0,0 +1,151 @@
+#include "glstate.h"
+
+GLState::GLState() {
+    invalidate();
+}
+
+void GLState::invalidate() {
+    m_program = UNKNOWN;
+    m_vao = UNKNOWN;
+    m_activeUnit = -1;
+    m_textures.fill(UNKNOWN);
+    m_caps.fill(-1);
+    invalidateFramebuffer();
+}
+
+void GLState::invalidateFramebuffer() {
+    m_fbo = UNKNOWN;
+    m_viewport.fill(-1);
+}
+
+void GLState::useProgram(GLuint program) {
+    if (m_program == program) {
+        m_stats.elided++;
+        return;
+    }
+    glUseProgram(program);
+    m_program = program;
+    m_stats.issued++;
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if (m_vao == vao) {
+        m_stats.elided++;
+        return;
+    }
+    glBindVertexArray(vao);
+    m_vao = vao;
+    m_stats.issued++;
+}
+
+void GLState::bindFramebuffer(GLuint fbo) {
+    if (m_fbo == fbo) {
+        m_stats.elided++;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    m_fbo = fbo;
+    m_stats.issued++;
+}
+
+void GLState::activeTexture(int unit) {
+    if (m_activeUnit == unit) {
+        m_stats.elided++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    m_activeUnit = unit;
+    m_stats.issued++;
+}
+
+void GLState::bindTexture(int unit, GLuint texture) {
+    if (unit < 0 || unit >= MAX_TEXTURE_UNITS) {
+        // Untracked unit: always issue, and forget what we think is active
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        m_activeUnit = -1;
+        m_stats.issued += 2;
+        return;
+    }
+
+    if (m_textures[unit] == texture) {
+        m_stats.elided++;
+        return;
+    }
+    activeTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    m_textures[unit] = texture;
+    m_stats.issued++;
+}
+
+void GLState::bindBufferTexture(int unit, GLuint texture) {
+    if (unit < 0 || unit >= MAX_TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = -1;
+    }
+    else {
+        activeTexture(unit);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    m_stats.issued++;
+}
+
+void GLState::viewport(int x, int y, int width, int height) {
+    if (m_viewport[0] == x && m_viewport[1] == y &&
+        m_viewport[2] == width && m_viewport[3] == height) {
+        m_stats.elided++;
+        return;
+    }
+    glViewport(x, y, width, height);
+    m_viewport = {x, y, width, height};
+    m_stats.issued++;
+}
+
+int GLState::capIndex(GLenum cap) const {
+    switch (cap) {
+    case GL_DEPTH_TEST:   return 0;
+    case GL_CULL_FACE:    return 1;
+    case GL_BLEND:        return 2;
+    case GL_STENCIL_TEST: return 3;
+    case GL_SCISSOR_TEST: return 4;
+    default:              return -1;
+    }
+}
+
+void GLState::setCap(GLenum cap, bool on) {
+    int i = capIndex(cap);
+    if (i >= 0 && m_caps[i] == (on ? 1 : 0)) {
+        m_stats.elided++;
+        return;
+    }
+    if (on) glEnable(cap);
+    else    glDisable(cap);
+    if (i >= 0) m_caps[i] = on ? 1 : 0;
+    m_stats.issued++;
+}
+
+void GLState::enable(GLenum cap) {
+    setCap(cap, true);
+}
+
+void GLState::disable(GLenum cap) {
+    setCap(cap, false);
+}
+
+void GLState::releaseProgram(GLuint program) {
+    if (m_program == program) m_program = UNKNOWN;
+}
+
+void GLState::releaseVertexArray(GLuint vao) {
+    if (m_vao == vao) m_vao = UNKNOWN;
+}
+
+void GLState::releaseFramebuffer(GLuint fbo) {
+    if (m_fbo == fbo) m_fbo = UNKNOWN;
+}
+
+void GLState::releaseTexture(GLuint texture) {
+    for (GLuint &bound : m_textures) {
+        if (bound == texture) bound = UNKNOWN;
+    }
+}
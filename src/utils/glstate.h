@@ -0,0 +1,68 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+
+// Counters for one frame's worth of state changes
+struct GLStateStats {
+    unsigned int issued = 0; // calls that actually reached the driver
+    unsigned int elided = 0; // calls skipped because the state was already set
+};
+
+// Thin shadow of the GL state we touch every frame. Every setter compares
+// against the cached value and only calls into GL when something changes.
+// Anything that bypasses this class must call the matching invalidate/release
+// helper, otherwise the cache will go stale.
+class GLState {
+public:
+    static constexpr int MAX_TEXTURE_UNITS = 16;
+
+    GLState();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindFramebuffer(GLuint fbo);
+    void bindTexture(int unit, GLuint texture); // GL_TEXTURE_2D on GL_TEXTURE0 + unit
+    void bindBufferTexture(int unit, GLuint texture); // GL_TEXTURE_BUFFER, rare enough to always issue
+    void viewport(int x, int y, int width, int height);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+
+    // Forget everything (e.g. after code we don't control touched the context)
+    void invalidate();
+    // Qt rebinds its FBO and resets the viewport around paintGL/resizeGL
+    void invalidateFramebuffer();
+
+    // GL unbinds deleted objects itself; keep the cache in sync so that a
+    // recycled name is not mistaken for an existing binding
+    void releaseProgram(GLuint program);
+    void releaseVertexArray(GLuint vao);
+    void releaseFramebuffer(GLuint fbo);
+    void releaseTexture(GLuint texture);
+
+    // Per-frame counters
+    void resetStats() { m_stats = GLStateStats(); }
+    const GLStateStats &getStats() const { return m_stats; }
+
+private:
+    static constexpr GLuint UNKNOWN = ~0u;
+    static constexpr int NUM_CAPS = 5;
+
+    int capIndex(GLenum cap) const;
+    void setCap(GLenum cap, bool on);
+    void activeTexture(int unit);
+
+    GLuint m_program;
+    GLuint m_vao;
+    GLuint m_fbo;
+    int m_activeUnit;
+    std::array<GLuint, MAX_TEXTURE_UNITS> m_textures;
+    std::array<int, 4> m_viewport;
+    std::array<int, NUM_CAPS> m_caps; // -1 unknown, 0 off, 1 on
+
+    GLStateStats m_stats;
+};
@@ -0,0 +1,133 @@
+#include "indirectrenderer.h"
+#include "shaderloader.h"
+#include "stencilclass.h"
+
+#include <iostream>
+
+bool IndirectRenderer::isSupported() {
+    bool multiDraw = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object);
+    bool drawId = GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters;
+    return multiDraw && drawId;
+}
+
+bool IndirectRenderer::init(const std::unordered_map<PrimitiveType, GeometryHandle> &primitiveGeometry) {
+    if (!isSupported()) {
+        std::cout << "[IndirectRenderer] multi-draw indirect not available, using per-draw path" << std::endl;
+        return false;
+    }
+
+    m_program = ShaderLoader::createShaderProgram(
+        "resources/shaders/gbuffer_indirect.vert",
+        "resources/shaders/gbuffer_indirect.frag");
+    if (m_program == 0) {
+        std::cerr << "[IndirectRenderer] shader failed, using per-draw path" << std::endl;
+        return false;
+    }
+
+    m_geometry = primitiveGeometry;
+
+    glGenBuffers(1, &m_objectBuffer);
+
+    std::cout << "[IndirectRenderer] using glMultiDrawElementsIndirect" << std::endl;
+    return true;
+}
+
+void IndirectRenderer::destroy(GLState &glState) {
+    if (m_program) {
+        glState.releaseProgram(m_program);
+        glDeleteProgram(m_program);
+        m_program = 0;
+    }
+    glDeleteBuffers(1, &m_objectBuffer);
+    m_objectBuffer = 0;
+}
+
+std::vector<CullObject> IndirectRenderer::setScene(const RenderData &renderData, const MaterialTable &materials) {
+    std::vector<IndirectObject> objects;
+    std::vector<CullObject> cullObjects;
+    const RenderShapes &shapes = renderData.shapes;
+    objects.reserve(shapes.size());
+    cullObjects.reserve(shapes.size());
+    m_objectGeometry.clear();
+
+    for (size_t s = 0; s < shapes.size(); s++) {
+        auto geometry = m_geometry.find(shapes.types[s]);
+        if (geometry == m_geometry.end()) continue; // meshes have no geometry yet
+
+        IndirectObject o;
+        o.model = shapes.ctms[s];
+        o.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(shapes.ctms[s]))));
+        uint16_t material = materials.getShapeMaterial(s);
+        o.material = glm::uvec4(material, 0, 0, 0);
+        objects.push_back(o);
+
+        CullObject c;
+        c.boundsMin = shapes.boundsMin[s];
+        c.boundsMax = shapes.boundsMax[s];
+        c.stencilClass = materials.getStencilClass(material);
+        c.material = material;
+        c.geometry = (uint16_t)shapes.types[s];
+        cullObjects.push_back(c);
+        m_objectGeometry.push_back(geometry->second);
+    }
+
+    // The object table only changes with the scene
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(IndirectObject), objects.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_commands.reserve(objects.size());
+    m_drawObjects.reserve(objects.size());
+    return cullObjects;
+}
+
+bool IndirectRenderer::draw(const FramePacket &packet, const GeometryArena &geometry, UploadRing &ring, GLState &glState) {
+    m_commands.clear();
+    m_drawObjects.clear();
+
+    // Culling and sorting are done; only the arena ranges are looked up
+    // here, since they may have moved since the packet was prepared
+    for (const DrawItem &d : packet.draws) {
+        const GeometryRange &r = geometry.get(m_objectGeometry[d.object]);
+        m_commands.push_back({r.indexCount, 1, r.firstIndex, r.baseVertex, 0});
+        m_drawObjects.push_back(d.object);
+    }
+
+    // One multi-draw per stencil class, since the reference value can't
+    // change inside a single call. The packet is sorted by class already.
+    const GLuint classes[2] = {STENCIL_LIT, STENCIL_EMISSIVE_ONLY};
+    size_t partitionStart[3] = {0, packet.litCount, m_commands.size()};
+    if (m_commands.empty()) return true;
+
+    // Everything goes into this frame's region of the ring; no buffer the GPU
+    // may still be reading is touched. gl_DrawIDARB restarts at 0 for every
+    // call, so each partition gets its own draw-object array.
+    GLintptr commandOffset = ring.upload(m_commands.data(), m_commands.size() * sizeof(DrawElementsIndirectCommand));
+    GLintptr drawObjectOffset[2];
+    for (int c = 0; c < 2; c++) {
+        size_t count = partitionStart[c + 1] - partitionStart[c];
+        drawObjectOffset[c] = count ? ring.upload(&m_drawObjects[partitionStart[c]], count * sizeof(GLuint)) : 0;
+        if (drawObjectOffset[c] == UploadRing::INVALID) return false;
+    }
+    if (commandOffset == UploadRing::INVALID) return false;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+
+    glState.useProgram(m_program);
+    glState.bindVertexArray(geometry.getVAO());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.getBuffer());
+
+    for (int c = 0; c < 2; c++) {
+        size_t count = partitionStart[c + 1] - partitionStart[c];
+        if (count == 0) continue;
+
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, ring.getBuffer(), drawObjectOffset[c], count * sizeof(GLuint));
+        glStencilFunc(GL_ALWAYS, classes[c], 0xFF);
+
+        GLintptr offset = commandOffset + partitionStart[c] * sizeof(DrawElementsIndirectCommand);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset, (GLsizei)count, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
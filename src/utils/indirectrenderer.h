@@ -0,0 +1,77 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include "sceneparser.h"
+#include "glstate.h"
+#include "geometryarena.h"
+#include "uploadring.h"
+#include "materialtable.h"
+#include "framepipeline.h"
+
+// Matches GL's DrawElementsIndirectCommand layout
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// One entry per shape in the object table (std430 layout)
+struct IndirectObject {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    glm::uvec4 material; // x = MaterialTable ID
+};
+
+// G-buffer submission backend for GL 4.3+ contexts: the visible shapes of a
+// frame (culled by the FramePipeline) are written as indirect commands and drawn out of the geometry arena
+// with one glMultiDrawElementsIndirect per stencil class. The vertex shader
+// fetches each draw's transform and material ID through gl_DrawIDARB.
+class IndirectRenderer {
+public:
+    // Runtime check for multi-draw indirect, SSBOs and gl_DrawIDARB
+    static bool isSupported();
+
+    // Compiles the shaders and remembers where each primitive lives in the
+    // arena. Returns false (and stays unusable) if anything fails.
+    bool init(const std::unordered_map<PrimitiveType, GeometryHandle> &primitiveGeometry);
+    void destroy(GLState &glState);
+    bool isReady() const { return m_program != 0; }
+
+    // Upload the per-shape object table; call whenever the scene changes,
+    // after the material table has been built for it. Returns what to cull,
+    // in object table order.
+    std::vector<CullObject> setScene(const RenderData &renderData, const MaterialTable &materials);
+
+    // Stream the packet's draws through the upload ring as commands and
+    // submit them in one call per stencil class. Expects the G-buffer, the
+    // FrameData block and the class-writing stencil state to be set up.
+    // Returns false if the ring had no room (draw another way).
+    bool draw(const FramePacket &packet, const GeometryArena &geometry, UploadRing &ring, GLState &glState);
+
+    int getLastDrawCount() const { return (int)m_commands.size(); }
+
+private:
+    GLuint m_program = 0;
+    GLuint m_objectBuffer = 0; // SSBO binding 0: IndirectObject per shape
+                               // SSBO binding 1: object index per draw (ring)
+
+    std::unordered_map<PrimitiveType, GeometryHandle> m_geometry;
+
+    // Per shape, in object table order. Handles rather than ranges, since the
+    // arena may move data around between frames.
+    std::vector<GeometryHandle> m_objectGeometry;
+
+    // Rebuilt every frame
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<GLuint> m_drawObjects;
+};
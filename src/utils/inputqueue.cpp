@@ -0,0 +1,21 @@
+#include "inputqueue.h"
+
+bool InputQueue::push(const InputEvent &event) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) return false;
+
+    m_events[tail & (CAPACITY - 1)] = event;
+    // Publish the slot only once it's written
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent &event) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+    event = m_events[head & (CAPACITY - 1)];
+    // Hand the slot back only once it's read
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Key or mouse event recorded on the GUI thread for the render thread
+struct InputEvent {
+    enum Type : uint8_t { KEY_PRESS, KEY_RELEASE, MOUSE_PRESS, MOUSE_RELEASE, MOUSE_MOVE };
+
+    Type type = KEY_PRESS;
+    int key = 0;             // Qt::Key, key events only
+    bool leftButton = false; // held after a mouse event
+    glm::vec2 position{0.f}; // widget coordinates, mouse events only
+};
+
+// Single-producer, single-consumer ring of input events. The GUI thread
+// pushes and the render thread pops; each side only ever writes its own
+// index, so neither blocks the other.
+class InputQueue {
+public:
+    // Power of two; the render thread drains it every repaint tick
+    static constexpr size_t CAPACITY = 1024;
+
+    // GUI thread. Drops the event and returns false if the render thread
+    // has fallen a whole queue behind.
+    bool push(const InputEvent &event);
+    // Render thread. False once the queue is empty.
+    bool pop(InputEvent &event);
+
+private:
+    std::array<InputEvent, CAPACITY> m_events;
+    alignas(64) std::atomic<size_t> m_head{0}; // next to pop, written by the consumer
+    alignas(64) std::atomic<size_t> m_tail{0}; // next to push, written by the producer
+};
@@ -0,0 +1,325 @@
+#include "jobsystem.h"
+
+namespace {
+
+// Every thread takes its jobs round-robin from a ring of its own. Jobs still
+// busy when their turn comes round are skipped; if several in a row are,
+// far more jobs are in flight than usual and a heap job stands in.
+constexpr size_t JOB_POOL_SIZE = 1024;
+struct JobPool {
+    std::unique_ptr<Job[]> jobs{new Job[JOB_POOL_SIZE]};
+    size_t next = 0;
+};
+
+}
+
+// A system's pools. A thread that exits hands its pool back for the next
+// new thread, busy jobs and all: they're skipped until they're done.
+struct JobPools {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<JobPool>> pools;
+    std::vector<JobPool*> free;
+
+    JobPool *acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free.empty()) {
+            JobPool *pool = free.back();
+            free.pop_back();
+            return pool;
+        }
+        pools.push_back(std::make_unique<JobPool>());
+        return pools.back().get();
+    }
+
+    void release(JobPool *pool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(pool);
+    }
+};
+
+namespace {
+
+// The pools the current thread holds, one per system it has queued jobs on
+struct ThreadPools {
+    std::vector<std::pair<std::shared_ptr<JobPools>, JobPool*>> held;
+
+    ~ThreadPools() {
+        for (auto &[pools, pool] : held) {
+            pools->release(pool);
+        }
+    }
+};
+thread_local ThreadPools t_pools;
+
+// Which worker of which system the current thread is, if any
+struct WorkerIdentity {
+    const JobSystem *system = nullptr;
+    int index = -1;
+};
+thread_local WorkerIdentity t_worker;
+
+int currentWorker(const JobSystem *system) {
+    return t_worker.system == system ? t_worker.index : -1;
+}
+
+}
+
+// ---- Deque (Lê et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models", without the resizing) ----
+
+bool JobSystem::Deque::push(Job *job) {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY) return false;
+
+    m_jobs[b & (CAPACITY - 1)].store(job, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job *JobSystem::Deque::pop() {
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = m_jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last one: race the thieves for it
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job *JobSystem::Deque::steal() {
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Job *job = m_jobs[t & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr; // lost to the owner or another thief
+    }
+    return job;
+}
+
+// ---- JobSystem ----
+
+int JobSystem::defaultThreadCount() {
+    int cores = (int)std::thread::hardware_concurrency();
+    return std::max(1, cores - 1);
+}
+
+JobSystem &JobSystem::get() {
+    static JobSystem system;
+    return system;
+}
+
+JobSystem::JobSystem(int threads)
+    : m_pools(std::make_shared<JobPools>())
+{
+    for (int i = 0; i < threads; i++) {
+        m_deques.push_back(std::make_unique<Deque>());
+    }
+    for (int i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    m_exiting = true;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCond.notify_all();
+    }
+    for (std::thread &t : m_threads) {
+        t.join();
+    }
+}
+
+Job *JobSystem::allocateJob() {
+    JobPool *held = nullptr;
+    for (auto &[pools, pool] : t_pools.held) {
+        if (pools == m_pools) {
+            held = pool;
+            break;
+        }
+    }
+    if (!held) {
+        held = m_pools->acquire();
+        t_pools.held.emplace_back(m_pools, held);
+    }
+
+    JobPool &pool = *held;
+    for (int tries = 0; tries < 8; tries++) {
+        Job *job = &pool.jobs[pool.next];
+        pool.next = (pool.next + 1) % JOB_POOL_SIZE;
+        if (job->busy.load(std::memory_order_acquire)) continue;
+
+        job->busy.store(true, std::memory_order_relaxed);
+        job->pooled = true;
+        job->next = nullptr;
+        return job;
+    }
+    Job *job = new Job;
+    job->pooled = false;
+    return job;
+}
+
+void JobSystem::freeJob(Job *job) {
+    if (job->pooled) {
+        job->busy.store(false, std::memory_order_release);
+    }
+    else {
+        delete job;
+    }
+}
+
+void JobSystem::park(JobCounter &dependency, Job *job) {
+    {
+        // finish() takes the continuations under the same lock after the
+        // count has dropped, so the job is either parked here or run now
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (dependency.m_count.load(std::memory_order_acquire) != 0) {
+            job->next = dependency.m_continuations;
+            dependency.m_continuations = job;
+            return;
+        }
+    }
+    submit(job);
+}
+
+void JobSystem::wait(const JobCounter &counter) {
+    int worker = currentWorker(this);
+    while (!counter.isDone()) {
+        if (Job *job = findJob(worker)) {
+            execute(job);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    // Wait for the thread that brought it to zero to let go of it
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::submit(Job *job) {
+    int worker = currentWorker(this);
+    if (worker >= 0) {
+        if (!m_deques[worker]->push(job)) {
+            // Deque full: the caller has plenty queued already
+            execute(job);
+            return;
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(m_injectMutex);
+        m_injected.push_back(job);
+        m_injectedCount++;
+    }
+
+    // Pairs with the sleepers check in workerLoop: either this sees the
+    // sleeper, or the sleeper sees the new epoch
+    m_epoch++;
+    if (m_sleepers > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCond.notify_one();
+    }
+}
+
+void JobSystem::execute(Job *job) {
+    JobCounter *done = job->done;
+    job->invoke(job->storage);
+    job->destroy(job->storage);
+    // Hand the job back before the count drops: whoever waits on it may go
+    // on to reuse everything the job touched
+    freeJob(job);
+    finish(done);
+}
+
+void JobSystem::finish(JobCounter *counter) {
+    if (!counter) return;
+
+    // No lock while others are still outstanding
+    int count = counter->m_count.load(std::memory_order_relaxed);
+    while (count > 1) {
+        if (counter->m_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    // Possibly the last one. Dropping to zero under the lock lets wait()
+    // tell when this thread is done with the counter, which may then go
+    // out of scope.
+    Job *continuations = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations = counter->m_continuations;
+            counter->m_continuations = nullptr;
+        }
+    }
+    while (continuations) {
+        Job *job = continuations;
+        continuations = job->next;
+        job->next = nullptr;
+        submit(job);
+    }
+}
+
+Job *JobSystem::findJob(int worker) {
+    // Own jobs first, newest first
+    if (worker >= 0) {
+        if (Job *job = m_deques[worker]->pop()) return job;
+    }
+
+    if (m_injectedCount > 0) {
+        std::lock_guard<std::mutex> lock(m_injectMutex);
+        if (m_injectedHead < m_injected.size()) {
+            Job *job = m_injected[m_injectedHead++];
+            if (m_injectedHead == m_injected.size()) {
+                m_injected.clear();
+                m_injectedHead = 0;
+            }
+            m_injectedCount--;
+            return job;
+        }
+    }
+
+    // Steal the oldest (usually biggest) job of another worker
+    int count = (int)m_deques.size();
+    for (int i = 1; i <= count; i++) {
+        int victim = (worker + i + count) % count;
+        if (victim == worker) continue;
+        if (Job *job = m_deques[victim]->steal()) return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::workerLoop(int worker) {
+    t_worker = {this, worker};
+    while (!m_exiting) {
+        uint64_t epoch = m_epoch;
+        if (Job *job = findJob(worker)) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepers++;
+        m_sleepCond.wait(lock, [this, epoch] { return m_exiting || m_epoch != epoch; });
+        m_sleepers--;
+    }
+}
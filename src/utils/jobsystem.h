@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JobCounter;
+struct JobPools;
+
+// A queued function. Captures up to STORAGE bytes live inside the job;
+// every thread takes jobs from a pool of its own, so queueing one doesn't
+// touch the heap.
+struct Job {
+    static constexpr size_t STORAGE = 64;
+
+    alignas(std::max_align_t) unsigned char storage[STORAGE];
+    void (*invoke)(void *storage) = nullptr;
+    void (*destroy)(void *storage) = nullptr;
+    JobCounter *done = nullptr;
+    Job *next = nullptr;           // in a counter's continuation list
+    std::atomic<bool> busy{false}; // pooled jobs: in use
+    bool pooled = false;
+};
+
+// Number of jobs still to finish. Jobs can be made to wait for one to drop
+// to zero (JobSystem::runAfter), and any thread can wait for it while
+// helping with the work (JobSystem::wait).
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter &operator=(const JobCounter&) = delete;
+
+    bool isDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> m_count{0};
+    // Jobs to start once m_count drops to zero
+    mutable std::mutex m_mutex;
+    Job *m_continuations = nullptr;
+};
+
+// Work-stealing job scheduler. Every worker owns a Chase-Lev deque: it
+// pushes and pops its own jobs at the bottom (newest first, while they're
+// still in cache) and the others steal from the top when they run dry.
+// Threads that aren't workers hand their jobs in through a shared queue.
+class JobSystem {
+public:
+    // One worker per core, less the calling thread, which helps while waiting
+    static int defaultThreadCount();
+    // Shared by the whole program, created on first use
+    static JobSystem &get();
+
+    explicit JobSystem(int threads = defaultThreadCount());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem &operator=(const JobSystem&) = delete;
+
+    // Queue fn(); done (if given) counts it until it has run
+    template <typename F>
+    void run(F &&fn, JobCounter *done = nullptr) {
+        submit(makeJob(std::forward<F>(fn), done));
+    }
+    // Queue fn() once dependency has dropped to zero
+    template <typename F>
+    void runAfter(JobCounter &dependency, F &&fn, JobCounter *done = nullptr) {
+        park(dependency, makeJob(std::forward<F>(fn), done));
+    }
+
+    // Queue fn(begin, end) over [0, count) in ranges of at most grain
+    // items. fn is used in place, so it must outlive done.
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, const F &fn, JobCounter &done) {
+        if (count == 0) return;
+        runRange(&fn, 0, count, std::max<size_t>(grain, 1), done);
+    }
+    // Same, returning once every range has run
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, const F &fn) {
+        JobCounter done;
+        parallelFor(count, grain, fn, done);
+        wait(done);
+    }
+
+    // Run queued jobs on this thread until counter drops to zero
+    void wait(const JobCounter &counter);
+
+    int getThreadCount() const { return (int)m_threads.size(); }
+
+private:
+    // Chase-Lev work-stealing deque of fixed capacity. push/pop are the
+    // owner's only; steal may be called from any thread.
+    class Deque {
+    public:
+        static constexpr int64_t CAPACITY = 4096; // power of two
+
+        bool push(Job *job);
+        Job *pop();
+        Job *steal();
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Job*> m_jobs[CAPACITY];
+    };
+
+    template <typename F>
+    Job *makeJob(F &&fn, JobCounter *done) {
+        using T = std::decay_t<F>;
+        Job *job = allocateJob();
+        if constexpr (sizeof(T) <= Job::STORAGE && alignof(T) <= alignof(std::max_align_t)) {
+            new (job->storage) T(std::forward<F>(fn));
+            job->invoke = [](void *s) { (*static_cast<T*>(s))(); };
+            job->destroy = [](void *s) { static_cast<T*>(s)->~T(); };
+        }
+        else {
+            // Too big to keep inline
+            *reinterpret_cast<T**>(job->storage) = new T(std::forward<F>(fn));
+            job->invoke = [](void *s) { (**static_cast<T**>(s))(); };
+            job->destroy = [](void *s) { delete *static_cast<T**>(s); };
+        }
+        job->done = done;
+        if (done) done->m_count.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    template <typename F>
+    void runRange(const F *fn, size_t begin, size_t end, size_t grain, JobCounter &done) {
+        run([this, fn, begin, end, grain, &done] {
+            // Split off upper halves for other workers to steal and keep the
+            // lowest range, so big ranges spread out in log(n) steps
+            size_t last = end;
+            while (last - begin > grain) {
+                size_t middle = begin + (last - begin) / 2;
+                runRange(fn, middle, last, grain, done);
+                last = middle;
+            }
+            (*fn)(begin, last);
+        }, &done);
+    }
+
+    Job *allocateJob();
+    static void freeJob(Job *job);
+
+    void park(JobCounter &dependency, Job *job);
+    void submit(Job *job);
+    void execute(Job *job);
+    void finish(JobCounter *counter);
+    Job *findJob(int worker);
+    void workerLoop(int worker);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Deque>> m_deques; // one per worker
+
+    // The job pools handed out to threads. Jobs may still be queued or
+    // running when the thread that made them exits, so the pools outlive
+    // their threads; shared with the threads that hold one.
+    std::shared_ptr<JobPools> m_pools;
+
+    // Jobs from threads that aren't workers, oldest at m_injectedHead. The
+    // vector is only cleared once drained, so it keeps its capacity.
+    std::mutex m_injectMutex;
+    std::vector<Job*> m_injected;
+    size_t m_injectedHead = 0;
+    std::atomic<int> m_injectedCount{0};
+
+    // Idle workers sleep here. Every submit bumps the epoch, so a worker
+    // that found nothing only sleeps if nothing came in since it looked.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCond;
+    std::atomic<uint64_t> m_epoch{0};
+    std::atomic<int> m_sleepers{0};
+    std::atomic<bool> m_exiting{false};
+};
@@ -0,0 +1,350 @@
+#include "jsoncursor.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_CURSOR_SSE2
+#endif
+
+namespace {
+
+bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+#ifdef JSON_CURSOR_SSE2
+// Bit i set where byte i of the 16 at p equals c
+unsigned matches(__m128i chunk, char c) {
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+#endif
+
+// First non-whitespace byte in [p, end), or end
+const char *findNonWhitespace(const char *p, const char *end) {
+#ifdef JSON_CURSOR_SSE2
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned space = matches(chunk, ' ') | matches(chunk, '\n') | matches(chunk, '\r') | matches(chunk, '\t');
+        unsigned other = ~space & 0xFFFF;
+        if (other) return p + std::countr_zero(other);
+        p += 16;
+    }
+#endif
+    while (p < end && isWhitespace(*p)) p++;
+    return p;
+}
+
+// First '"' or '\' in [p, end), or end
+const char *findQuoteOrEscape(const char *p, const char *end) {
+#ifdef JSON_CURSOR_SSE2
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned found = matches(chunk, '"') | matches(chunk, '\\');
+        if (found) return p + std::countr_zero(found);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+// First quote or bracket in [p, end), or end
+const char *findStructural(const char *p, const char *end) {
+#ifdef JSON_CURSOR_SSE2
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned found = matches(chunk, '"') | matches(chunk, '{') | matches(chunk, '}') |
+                         matches(chunk, '[') | matches(chunk, ']');
+        if (found) return p + std::countr_zero(found);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '{' && *p != '}' && *p != '[' && *p != ']') p++;
+    return p;
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(std::string &out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += (char)codepoint;
+    }
+    else if (codepoint < 0x800) {
+        out += (char)(0xC0 | codepoint >> 6);
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000) {
+        out += (char)(0xE0 | codepoint >> 12);
+        out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+    else {
+        out += (char)(0xF0 | codepoint >> 18);
+        out += (char)(0x80 | (codepoint >> 12 & 0x3F));
+        out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+}
+
+JsonCursor::JsonCursor(const char *data, size_t size)
+    : m_begin(data),
+      m_end(data + size),
+      m_pos(data)
+{
+}
+
+void JsonCursor::skipWhitespace() {
+    // Usually there's none, or a single space
+    if (m_pos < m_end && !isWhitespace(*m_pos)) return;
+    m_pos = findNonWhitespace(m_pos, m_end);
+}
+
+JsonCursor::Type JsonCursor::peek() {
+    skipWhitespace();
+    if (hasError() || m_pos == m_end) return Type::NONE;
+    switch (*m_pos) {
+    case '{': return Type::OBJECT;
+    case '[': return Type::ARRAY;
+    case '"': return Type::STRING;
+    case 't':
+    case 'f': return Type::BOOLEAN;
+    case 'n': return Type::NULL_VALUE;
+    case '-': return Type::NUMBER;
+    default: return *m_pos >= '0' && *m_pos <= '9' ? Type::NUMBER : Type::NONE;
+    }
+}
+
+size_t JsonCursor::mark() {
+    skipWhitespace();
+    return m_pos - m_begin;
+}
+
+bool JsonCursor::atEnd() {
+    skipWhitespace();
+    return m_pos == m_end;
+}
+
+bool JsonCursor::fail(size_t offset, const std::string &message) {
+    if (!hasError()) {
+        m_error = message;
+        m_errorOffset = offset;
+    }
+    return false;
+}
+
+void JsonCursor::getErrorLocation(int &line, int &column) const {
+    const char *at = m_begin + std::min<size_t>(m_errorOffset, m_end - m_begin);
+    line = 1 + (int)std::count(m_begin, at, '\n');
+    const char *lineStart = at;
+    while (lineStart > m_begin && lineStart[-1] != '\n') lineStart--;
+    column = 1 + (int)(at - lineStart);
+}
+
+bool JsonCursor::enter(char open, const char *what) {
+    if (hasError()) return false;
+    skipWhitespace();
+    if (m_pos == m_end || *m_pos != open) {
+        return fail(std::string("expected ") + what);
+    }
+    m_pos++;
+    return true;
+}
+
+int JsonCursor::next(char close) {
+    if (hasError()) return -1;
+    skipWhitespace();
+    if (m_pos < m_end) {
+        if (*m_pos == ',') {
+            m_pos++;
+            return 1;
+        }
+        if (*m_pos == close) {
+            m_pos++;
+            return 0;
+        }
+    }
+    fail(std::string("expected ',' or '") + close + "'");
+    return -1;
+}
+
+bool JsonCursor::readKey(std::string_view &key) {
+    if (peek() != Type::STRING) return fail("expected a field name");
+    if (!readString(key)) return false;
+    skipWhitespace();
+    if (m_pos == m_end || *m_pos != ':') return fail("expected ':'");
+    m_pos++;
+    return true;
+}
+
+bool JsonCursor::readNumber(double &out) {
+    if (peek() != Type::NUMBER) return fail("expected a number");
+    // from_chars takes neither a leading '+' nor "inf" after a '-', which
+    // leaves JSON's numbers (and leading zeros)
+    const char *start = m_pos;
+    if (*start == '-' && (start + 1 == m_end || start[1] < '0' || start[1] > '9')) {
+        return fail("invalid number");
+    }
+    auto [end, error] = std::from_chars(start, m_end, out);
+    if (error != std::errc()) return fail("invalid number");
+    m_pos = end;
+    return true;
+}
+
+bool JsonCursor::readBool(bool &out) {
+    if (peek() != Type::BOOLEAN) return fail("expected true or false");
+    std::string_view rest(m_pos, m_end - m_pos);
+    if (rest.starts_with("true")) {
+        out = true;
+        m_pos += 4;
+        return true;
+    }
+    if (rest.starts_with("false")) {
+        out = false;
+        m_pos += 5;
+        return true;
+    }
+    return fail("expected true or false");
+}
+
+bool JsonCursor::readString(std::string_view &out) {
+    if (peek() != Type::STRING) return fail("expected a string");
+    const char *start = ++m_pos;
+    const char *p = findQuoteOrEscape(start, m_end);
+    if (p < m_end && *p == '"') {
+        // No escapes: the text itself
+        out = std::string_view(start, p - start);
+        m_pos = p + 1;
+        return true;
+    }
+
+    // Find the real end, stepping over escaped characters, then decode
+    while (p < m_end && *p == '\\') {
+        if (p + 1 == m_end) break;
+        p = findQuoteOrEscape(p + 2, m_end);
+    }
+    if (p == m_end) return fail(start - 1 - m_begin, "unterminated string");
+    if (!decodeString(start, p)) return false;
+    out = m_scratch;
+    m_pos = p + 1;
+    return true;
+}
+
+bool JsonCursor::decodeString(const char *start, const char *end) {
+    m_scratch.clear();
+    for (const char *p = start; p < end; p++) {
+        if (*p != '\\') {
+            m_scratch += *p;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case '"': m_scratch += '"'; break;
+        case '\\': m_scratch += '\\'; break;
+        case '/': m_scratch += '/'; break;
+        case 'b': m_scratch += '\b'; break;
+        case 'f': m_scratch += '\f'; break;
+        case 'n': m_scratch += '\n'; break;
+        case 'r': m_scratch += '\r'; break;
+        case 't': m_scratch += '\t'; break;
+        case 'u': {
+            auto readHex = [&](const char *at, uint32_t &value) {
+                if (end - at < 4) return false;
+                value = 0;
+                for (int i = 0; i < 4; i++) {
+                    int digit = hexDigit(at[i]);
+                    if (digit < 0) return false;
+                    value = value << 4 | digit;
+                }
+                return true;
+            };
+            uint32_t codepoint;
+            if (!readHex(p + 1, codepoint)) return fail(p - 1 - m_begin, "invalid \\u escape");
+            p += 4;
+            // A high surrogate takes the low one after it
+            uint32_t low;
+            if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - p > 6 && p[1] == '\\' && p[2] == 'u' &&
+                readHex(p + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                p += 6;
+            }
+            appendUtf8(m_scratch, codepoint);
+            break;
+        }
+        default:
+            return fail(p - 1 - m_begin, "invalid escape in string");
+        }
+    }
+    return true;
+}
+
+bool JsonCursor::skipString() {
+    const char *start = m_pos++;
+    const char *p = findQuoteOrEscape(m_pos, m_end);
+    while (p < m_end && *p == '\\') {
+        if (p + 1 == m_end) break;
+        p = findQuoteOrEscape(p + 2, m_end);
+    }
+    if (p == m_end) return fail(start - m_begin, "unterminated string");
+    m_pos = p + 1;
+    return true;
+}
+
+bool JsonCursor::skipContainer() {
+    const char *start = m_pos++;
+    int depth = 1;
+    while (depth > 0) {
+        m_pos = findStructural(m_pos, m_end);
+        if (m_pos == m_end) return fail(start - m_begin, "unterminated object or array");
+        switch (*m_pos) {
+        case '"':
+            if (!skipString()) return false;
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        default:
+            depth--;
+            break;
+        }
+        m_pos++;
+    }
+    return true;
+}
+
+bool JsonCursor::skipValue() {
+    switch (peek()) {
+    case Type::OBJECT:
+    case Type::ARRAY:
+        return skipContainer();
+    case Type::STRING:
+        return skipString();
+    case Type::NUMBER: {
+        double unused;
+        return readNumber(unused);
+    }
+    case Type::BOOLEAN: {
+        bool unused;
+        return readBool(unused);
+    }
+    case Type::NULL_VALUE:
+        if (std::string_view(m_pos, m_end - m_pos).starts_with("null")) {
+            m_pos += 4;
+            return true;
+        }
+        return fail("expected null");
+    default:
+        return fail("expected a value");
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// On-demand JSON reader over a buffer, typically a memory-mapped file.
+// Nothing is built up front: values are read where the cursor stands, as
+// the caller asks for them, and whatever it doesn't ask for is skipped.
+// Whitespace, strings and skipped containers are scanned 16 bytes at a time
+// (SSE2, with a plain loop elsewhere); numbers go through std::from_chars.
+//
+// Skipped values are only checked for balanced brackets and closed strings.
+// Errors record an offset and a message; the first one recorded sticks, and
+// every read returns false from then on.
+class JsonCursor {
+public:
+    enum class Type { NONE, OBJECT, ARRAY, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+    JsonCursor(const char *data, size_t size);
+
+    // Type of the value at the cursor; NONE if there isn't one
+    Type peek();
+    // Offset of the value at the cursor, for errors about it and for seek()
+    size_t mark();
+    void seek(size_t offset) { m_pos = m_begin + offset; }
+    // Offset of the key readObject() last passed to its callback
+    size_t getFieldOffset() const { return m_fieldOffset; }
+    // Nothing but whitespace left
+    bool atEnd();
+
+    // Each reads the value at the cursor and moves past it, or records an
+    // error and returns false if it isn't one of those
+    bool readNumber(double &out);
+    // Views the buffer, or scratch storage if the string had escapes; the
+    // latter only lasts until the next string is read
+    bool readString(std::string_view &out);
+    bool readBool(bool &out);
+    bool skipValue();
+
+    // Calls field(key) for every member, which must read or skip its value
+    // and return whether that worked
+    template <typename F>
+    bool readObject(F &&field);
+    // Calls element(index) for every element, likewise
+    template <typename F>
+    bool readArray(F &&element);
+
+    bool fail(size_t offset, const std::string &message);
+    bool fail(const std::string &message) { return fail(mark(), message); }
+    bool hasError() const { return !m_error.empty(); }
+    const std::string &getError() const { return m_error; }
+    size_t getErrorOffset() const { return m_errorOffset; }
+    // 1-based line and column of the error
+    void getErrorLocation(int &line, int &column) const;
+
+private:
+    void skipWhitespace();
+    bool enter(char open, const char *what);
+    // After an element: 1 if another follows, 0 at close, -1 on an error
+    int next(char close);
+    bool readKey(std::string_view &key);
+    bool skipString();
+    bool skipContainer();
+    bool decodeString(const char *start, const char *end);
+
+    const char *m_begin;
+    const char *m_end;
+    const char *m_pos;
+    std::string m_scratch;
+    size_t m_fieldOffset = 0;
+
+    std::string m_error;
+    size_t m_errorOffset = 0;
+};
+
+template <typename F>
+bool JsonCursor::readObject(F &&field) {
+    if (!enter('{', "an object")) return false;
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == '}') {
+        m_pos++;
+        return true;
+    }
+    while (true) {
+        std::string_view key;
+        m_fieldOffset = mark();
+        if (!readKey(key) || !field(key)) return false;
+        int more = next('}');
+        if (more <= 0) return more == 0;
+    }
+}
+
+template <typename F>
+bool JsonCursor::readArray(F &&element) {
+    if (!enter('[', "an array")) return false;
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == ']') {
+        m_pos++;
+        return true;
+    }
+    for (size_t index = 0;; index++) {
+        if (!element(index)) return false;
+        int more = next(']');
+        if (more <= 0) return more == 0;
+    }
+}
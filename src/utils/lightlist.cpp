@@ -0,0 +1,113 @@
+#include "lightlist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm/gtc/constants.hpp>
+
+namespace {
+
+// Cone with cosines below -1 everywhere: the spot falloff is always 1
+constexpr float ALL_AROUND_COS = -2.f;
+
+// Hard-edged spots would divide by zero; this makes the ramp a step
+constexpr float MAX_CONE_SCALE = 1e6f;
+
+SpotLightData makeSpot(const SceneLightData &light, float radius) {
+    SpotLightData s;
+    s.posRadius = glm::vec4(glm::vec3(light.pos), radius);
+    s.color = light.color;
+    s.atten = glm::vec4(light.function, 0.f);
+
+    if (light.type != LightType::LIGHT_SPOT) {
+        s.dirCosOuter = glm::vec4(0.f, -1.f, 0.f, ALL_AROUND_COS);
+        s.cone = glm::vec4(1.f, glm::pi<float>(), 0.f, 0.f);
+        return s;
+    }
+
+    // Falloff from 1 at the inner cone to 0 at the outer, ramped on the
+    // cosine instead of the angle so the shader never needs acos
+    float outer = light.angle;
+    float inner = std::max(light.angle - light.penumbra, 0.f);
+    float cosOuter = std::cos(outer);
+    float cosInner = std::cos(inner);
+    float range = cosInner - cosOuter;
+
+    s.dirCosOuter = glm::vec4(glm::normalize(glm::vec3(light.dir)), cosOuter);
+    s.cone = glm::vec4(range > 1.f / MAX_CONE_SCALE ? 1.f / range : MAX_CONE_SCALE, outer, 0.f, 0.f);
+    return s;
+}
+
+}
+
+float LightList::influenceRadius(const SceneLightData &light) {
+    float brightest = std::max({light.color.r, light.color.g, light.color.b});
+    if (brightest <= 0.f) return 0.f;
+
+    // Solve c0 + c1 d + c2 d^2 = brightest / CUTOFF for d
+    float c0 = light.function.x;
+    float c1 = light.function.y;
+    float c2 = light.function.z;
+    float target = brightest / CUTOFF;
+    if (target <= c0) return 0.f;
+
+    if (c2 > 1e-6f) {
+        return (-c1 + std::sqrt(c1 * c1 - 4.f * c2 * (c0 - target))) / (2.f * c2);
+    }
+    if (c1 > 1e-6f) {
+        return (target - c0) / c1;
+    }
+    return INFINITY;
+}
+
+void LightList::build(const RenderData &renderData, bool useVolumes) {
+    m_uniforms = LightUniforms();
+    m_volumeLights.clear();
+    m_revision++;
+
+    const SceneGlobalData &g = renderData.globalData;
+    m_uniforms.coeffs = glm::vec4(g.ka, g.kd, g.ks, 0.f);
+
+    int &numDirectional = m_uniforms.lightCount.x;
+    int &numPoint = m_uniforms.lightCount.y;
+    int &numSpot = m_uniforms.lightCount.z;
+    int dropped = 0;
+
+    for (const SceneLightData &light : renderData.lights) {
+        if (light.type == LightType::LIGHT_DIRECTIONAL) {
+            if (numDirectional == MAX_LIGHTS) { dropped++; continue; }
+            DirectionalLightData &d = m_uniforms.directionals[numDirectional++];
+            // Same convention the shader has always used for directional lights
+            d.toLight = glm::vec4(glm::normalize(glm::vec3(light.dir)), 0.f);
+            d.color = light.color;
+            continue;
+        }
+
+        float radius = influenceRadius(light);
+        if (radius <= 0.f) continue; // never contributes
+
+        bool bounded = std::isfinite(radius);
+        if (useVolumes && bounded) {
+            m_volumeLights.push_back(makeSpot(light, radius));
+            continue;
+        }
+
+        float shaderRadius = bounded ? radius : 0.f;
+        if (light.type == LightType::LIGHT_POINT) {
+            if (numPoint == MAX_LIGHTS) { dropped++; continue; }
+            PointLightData &p = m_uniforms.points[numPoint++];
+            p.posRadius = glm::vec4(glm::vec3(light.pos), shaderRadius);
+            p.color = light.color;
+            p.atten = glm::vec4(light.function, 0.f);
+        }
+        else {
+            if (numSpot == MAX_LIGHTS) { dropped++; continue; }
+            m_uniforms.spots[numSpot++] = makeSpot(light, shaderRadius);
+        }
+    }
+
+    if (dropped > 0) {
+        std::cout << "[LightList] " << dropped << " lights over the per-type limit of "
+                  << MAX_LIGHTS << " were dropped" << std::endl;
+    }
+}
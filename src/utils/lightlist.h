@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "sceneparser.h"
+#include "uniformblocks.h"
+
+// The scene's lights, preprocessed once per scene load: split by type and
+// converted into the shader-side layout, with directions normalized, spot
+// cones turned into cosine thresholds and influence radii solved from the
+// attenuation. The lighting shaders then need no per-pixel type branches,
+// normalizes of light data, or acos.
+class LightList {
+public:
+    // Lights are cut off once attenuation drops below this fraction
+    static constexpr float CUTOFF = 1.f / 256.f;
+
+    // Rebuild from the scene. With useVolumes, bounded point and spot lights
+    // are listed for the light-volume pass instead of the fullscreen block.
+    void build(const RenderData &renderData, bool useVolumes);
+
+    // Distance at which the light's contribution falls below CUTOFF, or
+    // INFINITY if its attenuation never gets there
+    static float influenceRadius(const SceneLightData &light);
+
+    // Contents of the LightData block for the fullscreen pass
+    const LightUniforms &getUniforms() const { return m_uniforms; }
+    // Point and spot lights for the volume pass (points as all-around spots)
+    const std::vector<SpotLightData> &getVolumeLights() const { return m_volumeLights; }
+    // Bumped by every build(), for passes that cache lit results
+    uint64_t getRevision() const { return m_revision; }
+
+private:
+    LightUniforms m_uniforms;
+    std::vector<SpotLightData> m_volumeLights;
+    uint64_t m_revision = 0;
+};
@@ -0,0 +1,167 @@
+#include "lightvolumes.h"
+#include "primitivemesh.h"
+#include "shaderloader.h"
+#include "uniformblocks.h"
+#include "stencilclass.h"
+#include "materialtable.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+// Proxy tessellation, independent of the shape parameter sliders
+constexpr int PROXY_PARAM1 = 16;
+constexpr int PROXY_PARAM2 = 16;
+// Tessellated proxies sit inside the true surface; grow them to compensate
+constexpr float PROXY_PADDING = 1.1f;
+// Wider spots are bounded by a sphere instead of a very flat cone
+constexpr float MAX_CONE_ANGLE = 1.05f; // ~60 degrees
+
+GeometryHandle allocateProxy(PrimitiveType type, GeometryArena &arena, GLState &glState) {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    buildIndexedMesh(generatePrimitiveData(type, PROXY_PARAM1, PROXY_PARAM2), vertices, indices);
+    return arena.allocate(vertices, indices, glState);
+}
+
+void bindBlock(GLuint program, const char *name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(program, name);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+}
+}
+
+bool LightVolumes::init(GeometryArena &arena, GLState &glState) {
+    m_stencilProgram = ShaderLoader::createShaderProgram(
+        "resources/shaders/lightVolume.vert",
+        "resources/shaders/lightVolumeStencil.frag");
+    m_shadeProgram = ShaderLoader::createShaderProgram(
+        "resources/shaders/lightVolume.vert",
+        "resources/shaders/lightVolume.frag");
+    if (m_stencilProgram == 0 || m_shadeProgram == 0) {
+        std::cerr << "[LightVolumes] shader failed, lighting all lights fullscreen" << std::endl;
+        destroy(arena, glState);
+        return false;
+    }
+
+    bindBlock(m_stencilProgram, "FrameData", FRAME_BLOCK_BINDING);
+    bindBlock(m_stencilProgram, "VolumeLight", VOLUME_LIGHT_BLOCK_BINDING);
+    bindBlock(m_shadeProgram, "FrameData", FRAME_BLOCK_BINDING);
+    bindBlock(m_shadeProgram, "LightData", LIGHT_BLOCK_BINDING);
+    bindBlock(m_shadeProgram, "VolumeLight", VOLUME_LIGHT_BLOCK_BINDING);
+
+    glState.useProgram(m_shadeProgram);
+    glUniform1i(glGetUniformLocation(m_shadeProgram, "gPosition"), 0);
+    glUniform1i(glGetUniformLocation(m_shadeProgram, "gNormal"), 1);
+    glUniform1i(glGetUniformLocation(m_shadeProgram, "gMaterial"), 2);
+    glUniform1i(glGetUniformLocation(m_shadeProgram, "materials"), MATERIAL_TEXTURE_UNIT);
+    glState.useProgram(0);
+
+    m_sphere = allocateProxy(PrimitiveType::PRIMITIVE_SPHERE, arena, glState);
+    m_cone = allocateProxy(PrimitiveType::PRIMITIVE_CONE, arena, glState);
+    return true;
+}
+
+void LightVolumes::destroy(GeometryArena &arena, GLState &glState) {
+    for (GLuint *program : {&m_stencilProgram, &m_shadeProgram}) {
+        if (*program) {
+            glState.releaseProgram(*program);
+            glDeleteProgram(*program);
+            *program = 0;
+        }
+    }
+    arena.free(m_sphere);
+    arena.free(m_cone);
+    m_sphere = m_cone = INVALID_GEOMETRY;
+}
+
+glm::mat4 LightVolumes::volumeTransform(const SpotLightData &light, bool &useCone) const {
+    glm::vec3 pos = glm::vec3(light.posRadius);
+    float r = light.posRadius.w * PROXY_PADDING;
+    float outerAngle = light.cone.y;
+
+    useCone = outerAngle < MAX_CONE_ANGLE;
+    if (!useCone) {
+        // Unit sphere has radius 0.5
+        glm::mat4 m(2.f * r);
+        m[3] = glm::vec4(pos, 1.f);
+        return m;
+    }
+
+    // Unit cone: apex at y = 0.5, base of radius 0.5 at y = -0.5. Move the
+    // apex to the origin, stretch it to the radius, and point -y along dir.
+    float baseRadius = r * std::tan(outerAngle) * PROXY_PADDING;
+    glm::vec3 axis = glm::vec3(light.dirCosOuter);
+    glm::vec3 up = std::abs(axis.y) < 0.99f ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(1.f, 0.f, 0.f);
+    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+    glm::vec3 y = -axis;
+    glm::vec3 z = glm::cross(x, y);
+
+    glm::mat4 m(1.f);
+    m[0] = glm::vec4(x * (2.f * baseRadius), 0.f);
+    m[1] = glm::vec4(y * r, 0.f);
+    m[2] = glm::vec4(z * (2.f * baseRadius), 0.f);
+    m[3] = glm::vec4(pos + axis * (0.5f * r), 1.f);
+    return m;
+}
+
+int LightVolumes::draw(const std::vector<SpotLightData> &lights, const GeometryArena &arena,
+                       UploadRing &ring, GLState &glState) {
+    glState.bindVertexArray(arena.getVAO());
+    glState.enable(GL_STENCIL_TEST);
+    // Keep back faces beyond the far plane so distant volumes still count
+    glState.enable(GL_DEPTH_CLAMP);
+    glDepthMask(GL_FALSE);
+    glBlendFunc(GL_ONE, GL_ONE);
+    // The counter lives in the low bits; the pixel class above it is kept.
+    // Wrapping inc/dec through the mask still counts correctly mod 64.
+    glStencilMask(STENCIL_VOLUME_MASK);
+
+    int drawn = 0;
+    for (const SpotLightData &light : lights) {
+        bool useCone;
+        VolumeLightUniforms block;
+        block.model = volumeTransform(light, useCone);
+        block.light = light;
+
+        GLintptr offset = ring.upload(&block, sizeof(block));
+        if (offset == UploadRing::INVALID) break;
+        glBindBufferRange(GL_UNIFORM_BUFFER, VOLUME_LIGHT_BLOCK_BINDING, ring.getBuffer(), offset, sizeof(block));
+
+        GeometryHandle proxy = useCone ? m_cone : m_sphere;
+
+        // 1. Mark lit pixels whose surface lies inside the volume: back faces
+        //    behind the surface count up, front faces behind it count down
+        glState.useProgram(m_stencilProgram);
+        glState.enable(GL_DEPTH_TEST);
+        glState.disable(GL_CULL_FACE);
+        glState.disable(GL_BLEND);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glStencilFunc(GL_EQUAL, STENCIL_LIT, STENCIL_LIT);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        arena.draw(proxy);
+
+        // 2. Shade the marked pixels through the back faces (works with the
+        //    camera inside the volume) and clear the marks as we go
+        glState.useProgram(m_shadeProgram);
+        glState.disable(GL_DEPTH_TEST);
+        glState.enable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glState.enable(GL_BLEND);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilFunc(GL_NOTEQUAL, 0, STENCIL_VOLUME_MASK);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        arena.draw(proxy);
+        glCullFace(GL_BACK);
+
+        drawn++;
+    }
+
+    glDepthMask(GL_TRUE);
+    glStencilMask(0xFF);
+    glState.disable(GL_DEPTH_CLAMP);
+    glState.disable(GL_BLEND);
+    glState.disable(GL_STENCIL_TEST);
+    glState.disable(GL_DEPTH_TEST);
+    return drawn;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "glstate.h"
+#include "geometryarena.h"
+#include "uploadring.h"
+#include "uniformblocks.h"
+
+// Lighting for point and spot lights, one proxy mesh per light: a sphere
+// bounding the light's influence radius, or a cone for narrow spots. Each
+// light first marks the G-buffer pixels inside its volume in the stencil
+// buffer, then shades only those pixels and adds the result to the lighting
+// target. Cost scales with each light's screen footprint instead of the
+// full screen.
+class LightVolumes {
+public:
+    bool init(GeometryArena &arena, GLState &glState);
+    void destroy(GeometryArena &arena, GLState &glState);
+    bool isReady() const { return m_shadeProgram != 0; }
+
+    // Accumulate the given lights (LightList::getVolumeLights) into the bound
+    // lighting FBO, which must share the G-buffer's depth-stencil attachment.
+    // The G-buffer textures must be bound to units 0-3, the material table
+    // to its unit and the FrameData/LightData blocks to their binding points. Returns the number
+    // of volumes drawn.
+    int draw(const std::vector<SpotLightData> &lights, const GeometryArena &arena,
+             UploadRing &ring, GLState &glState);
+
+private:
+    glm::mat4 volumeTransform(const SpotLightData &light, bool &useCone) const;
+
+    GLuint m_stencilProgram = 0;
+    GLuint m_shadeProgram = 0;
+
+    GeometryHandle m_sphere = INVALID_GEOMETRY;
+    GeometryHandle m_cone = INVALID_GEOMETRY;
+};
@@ -0,0 +1,91 @@
+#include "materialtable.h"
+#include "stencilclass.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <iostream>
+#include <map>
+
+void MaterialTable::build(const RenderData &renderData) {
+    // The scene's materials are already interned, but differ in terms the
+    // renderer ignores; the table merges those too
+    const RenderShapes &shapes = renderData.shapes;
+    std::map<std::array<float, 10>, uint16_t> ids;
+    std::vector<uint16_t> sceneIds;
+    std::vector<glm::vec4> texels;
+    sceneIds.reserve(shapes.materialTable.size());
+    m_classes.clear();
+    m_revision++;
+
+    for (const SceneMaterial &mat : shapes.materialTable) {
+
+        // Like default.frag, a non-positive exponent means no highlight.
+        // Fold that into the table so the shaders never see pow(x, 0).
+        bool hasSpecular = mat.shininess > 0.f;
+        glm::vec3 specular = hasSpecular ? glm::vec3(mat.cSpecular) : glm::vec3(0.f);
+        float shininess = hasSpecular ? mat.shininess : 1.f;
+
+        std::array<float, 10> key = {mat.cDiffuse.r, mat.cDiffuse.g, mat.cDiffuse.b,
+                                     specular.r, specular.g, specular.b, shininess,
+                                     mat.cEmissive.r, mat.cEmissive.g, mat.cEmissive.b};
+        auto found = ids.find(key);
+        if (found != ids.end()) {
+            sceneIds.push_back(found->second);
+            continue;
+        }
+        if ((int)m_classes.size() == MAX_MATERIALS) {
+            std::cerr << "[MaterialTable] more than " << MAX_MATERIALS
+                      << " materials, reusing material 0" << std::endl;
+            sceneIds.push_back(0);
+            continue;
+        }
+
+        uint16_t id = (uint16_t)m_classes.size();
+        ids.emplace(key, id);
+        sceneIds.push_back(id);
+        m_classes.push_back(stencilClass(mat));
+
+        texels.push_back(glm::vec4(glm::vec3(mat.cDiffuse), 1.f));
+        texels.push_back(glm::vec4(specular, shininess));
+        texels.push_back(glm::vec4(glm::vec3(mat.cEmissive), 1.f));
+    }
+
+    m_shapeMaterials.resize(shapes.size());
+    for (size_t s = 0; s < shapes.size(); s++) {
+        m_shapeMaterials[s] = sceneIds[shapes.materials[s]];
+    }
+
+    // Keep the texture valid for an empty scene
+    if (texels.empty()) texels.resize(TEXELS_PER_MATERIAL, glm::vec4(0.f));
+
+    if (!m_buffer) {
+        glGenBuffers(1, &m_buffer);
+        glGenTextures(1, &m_texture);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // The texture keeps referring to the buffer; attach once, the storage
+    // respecification above is picked up automatically
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    std::cout << "[MaterialTable] " << m_shapeMaterials.size() << " shapes -> "
+              << m_classes.size() << " materials" << std::endl;
+}
+
+void MaterialTable::destroy() {
+    glDeleteTextures(1, &m_texture);
+    glDeleteBuffers(1, &m_buffer);
+    m_texture = 0;
+    m_buffer = 0;
+    m_shapeMaterials.clear();
+    m_classes.clear();
+}
+
+void MaterialTable::bind(GLState &glState) const {
+    glState.bindBufferTexture(MATERIAL_TEXTURE_UNIT, m_texture);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "sceneparser.h"
+#include "glstate.h"
+
+// Texture unit the table is bound to in every shader that reads it
+constexpr int MATERIAL_TEXTURE_UNIT = 4;
+
+// The scene's distinct materials, deduplicated at load and stored in a
+// buffer texture. The G-buffer only records a 16-bit material ID per pixel;
+// the lighting shaders look the real diffuse, specular, shininess and
+// emissive terms up from here, and a draw only needs to set one integer.
+class MaterialTable {
+public:
+    // IDs must fit the R16UI G-buffer target
+    static constexpr int MAX_MATERIALS = 1 << 16;
+    // RGBA32F texels per material: diffuse, specular + shininess, emissive
+    static constexpr int TEXELS_PER_MATERIAL = 3;
+
+    // Deduplicate the materials of renderData's shapes and upload the table
+    void build(const RenderData &renderData);
+    void destroy();
+
+    // Bind the table to MATERIAL_TEXTURE_UNIT
+    void bind(GLState &glState) const;
+
+    // Material ID of renderData.shapes[shapeIndex]
+    uint16_t getShapeMaterial(size_t shapeIndex) const { return m_shapeMaterials[shapeIndex]; }
+    // STENCIL_LIT or STENCIL_EMISSIVE_ONLY for a material ID
+    unsigned int getStencilClass(uint16_t id) const { return m_classes[id]; }
+    int size() const { return (int)m_classes.size(); }
+    // Bumped by every build(), for passes that cache shaded results
+    uint64_t getRevision() const { return m_revision; }
+
+private:
+    GLuint m_buffer = 0;
+    GLuint m_texture = 0;
+
+    std::vector<uint16_t> m_shapeMaterials;
+    std::vector<unsigned int> m_classes;
+    uint64_t m_revision = 0;
+};
@@ -0,0 +1,95 @@
+#include "offsetallocator.h"
+
+void OffsetAllocator::reset(uint32_t capacity) {
+    m_freeByOffset.clear();
+    m_freeBySize.clear();
+    m_capacity = capacity;
+    m_freeSpace = 0;
+    if (capacity > 0) insertFree(0, capacity);
+}
+
+void OffsetAllocator::grow(uint32_t newCapacity) {
+    if (newCapacity <= m_capacity) return;
+    uint32_t oldCapacity = m_capacity;
+    m_capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+uint32_t OffsetAllocator::allocate(uint32_t size) {
+    if (size == 0) return INVALID;
+
+    auto best = m_freeBySize.lower_bound(size);
+    if (best == m_freeBySize.end()) return INVALID;
+
+    uint32_t offset = best->second;
+    take(m_freeByOffset.find(offset), size);
+    return offset;
+}
+
+uint32_t OffsetAllocator::allocateBelow(uint32_t size, uint32_t limit) {
+    if (size == 0) return INVALID;
+
+    for (auto it = m_freeByOffset.begin(); it != m_freeByOffset.end(); ++it) {
+        if (it->first + size > limit) break;
+        if (it->second >= size) {
+            uint32_t offset = it->first;
+            take(it, size);
+            return offset;
+        }
+    }
+    return INVALID;
+}
+
+void OffsetAllocator::free(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+
+    // Merge with the following block
+    auto next = m_freeByOffset.find(offset + size);
+    if (next != m_freeByOffset.end()) {
+        size += next->second;
+        eraseFree(next);
+    }
+
+    // Merge with the preceding block
+    auto prev = m_freeByOffset.lower_bound(offset);
+    if (prev != m_freeByOffset.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            eraseFree(prev);
+        }
+    }
+
+    insertFree(offset, size);
+}
+
+uint32_t OffsetAllocator::getLargestFreeBlock() const {
+    return m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first;
+}
+
+void OffsetAllocator::insertFree(uint32_t offset, uint32_t size) {
+    m_freeByOffset[offset] = size;
+    m_freeBySize.emplace(size, offset);
+    m_freeSpace += size;
+}
+
+void OffsetAllocator::eraseFree(std::map<uint32_t, uint32_t>::iterator it) {
+    auto range = m_freeBySize.equal_range(it->second);
+    for (auto s = range.first; s != range.second; ++s) {
+        if (s->second == it->first) {
+            m_freeBySize.erase(s);
+            break;
+        }
+    }
+    m_freeSpace -= it->second;
+    m_freeByOffset.erase(it);
+}
+
+// Carve `size` units off the front of a free block
+void OffsetAllocator::take(std::map<uint32_t, uint32_t>::iterator it, uint32_t size) {
+    uint32_t offset = it->first;
+    uint32_t blockSize = it->second;
+    eraseFree(it);
+    if (blockSize > size) insertFree(offset + size, blockSize - size);
+}
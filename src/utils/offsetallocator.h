@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+// Best-fit range allocator over [0, capacity) in abstract units (vertices,
+// indices, ...). Free blocks are kept both by size, for O(log n) best-fit
+// allocation, and by offset, so that freed ranges coalesce with their neighbours.
+class OffsetAllocator {
+public:
+    static constexpr uint32_t INVALID = ~0u;
+
+    void reset(uint32_t capacity);
+    // Extend the managed range; the new space merges with a free tail block
+    void grow(uint32_t newCapacity);
+
+    // Returns the offset of a block of `size` units, or INVALID
+    uint32_t allocate(uint32_t size);
+    // Like allocate(), but only from the lowest free block that ends at or
+    // before `limit` (used to compact allocations towards the start)
+    uint32_t allocateBelow(uint32_t size, uint32_t limit);
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t getCapacity() const { return m_capacity; }
+    uint32_t getFreeSpace() const { return m_freeSpace; }
+    uint32_t getLargestFreeBlock() const;
+
+private:
+    void insertFree(uint32_t offset, uint32_t size);
+    void eraseFree(std::map<uint32_t, uint32_t>::iterator it);
+    void take(std::map<uint32_t, uint32_t>::iterator it, uint32_t size);
+
+    uint32_t m_capacity = 0;
+    uint32_t m_freeSpace = 0;
+
+    std::map<uint32_t, uint32_t> m_freeByOffset;    // offset -> size
+    std::multimap<uint32_t, uint32_t> m_freeBySize; // size -> offset
+};
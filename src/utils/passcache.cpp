@@ -0,0 +1,10 @@
+#include "passcache.h"
+
+bool PassCache::isValid(const std::string &pass, const Inputs &inputs) const {
+    auto found = m_inputs.find(pass);
+    return found != m_inputs.end() && found->second == inputs;
+}
+
+void PassCache::update(const std::string &pass, const Inputs &inputs) {
+    m_inputs[pass] = inputs;
+}
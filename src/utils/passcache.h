@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Revisions of the state each pass consumed when it last produced its
+// (persistent) output. While a pass's inputs are unchanged the frame can
+// leave it out and read the output of its last run instead.
+class PassCache {
+public:
+    // Up to 8 revisions, the rest zero; fixed-size so a frame can build and
+    // capture them without allocating
+    using Inputs = std::array<uint64_t, 8>;
+
+    // True if the pass last ran with exactly these inputs
+    bool isValid(const std::string &pass, const Inputs &inputs) const;
+    // Record the inputs the pass just ran with
+    void update(const std::string &pass, const Inputs &inputs);
+    // Forget everything, e.g. after the outputs were reallocated
+    void invalidate() { m_inputs.clear(); }
+
+private:
+    std::unordered_map<std::string, Inputs> m_inputs;
+};
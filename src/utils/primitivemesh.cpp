@@ -0,0 +1,54 @@
+#include "primitivemesh.h"
+
+#include "cube.h"
+#include "cone.h"
+#include "sphere.h"
+#include "cylinder.h"
+
+#include <array>
+#include <map>
+
+std::vector<float> generatePrimitiveData(PrimitiveType type, int param1, int param2) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE: {
+        Cube c;
+        c.updateParams(param1, param2);
+        return c.generateShape();
+    }
+    case PrimitiveType::PRIMITIVE_SPHERE: {
+        Sphere s;
+        s.updateParams(param1, param2);
+        return s.generateShape();
+    }
+    case PrimitiveType::PRIMITIVE_CYLINDER: {
+        Cylinder c;
+        c.updateParams(param1, param2);
+        return c.generateShape();
+    }
+    case PrimitiveType::PRIMITIVE_CONE: {
+        Cone c;
+        c.updateParams(param1, param2);
+        return c.generateShape();
+    }
+    default:
+        return std::vector<float>();
+    }
+}
+
+void buildIndexedMesh(const std::vector<float> &triangles,
+                      std::vector<float> &outVertices,
+                      std::vector<uint32_t> &outIndices) {
+    outVertices.clear();
+    outIndices.clear();
+    outIndices.reserve(triangles.size() / 6);
+
+    // Exact match is enough: shared corners are generated by the same math
+    std::map<std::array<float, 6>, uint32_t> unique;
+    for (size_t i = 0; i + 5 < triangles.size(); i += 6) {
+        std::array<float, 6> v = {triangles[i],     triangles[i + 1], triangles[i + 2],
+                                  triangles[i + 3], triangles[i + 4], triangles[i + 5]};
+        auto [it, inserted] = unique.emplace(v, (uint32_t)(outVertices.size() / 6));
+        if (inserted) outVertices.insert(outVertices.end(), v.begin(), v.end());
+        outIndices.push_back(it->second);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "scenedata.h"
+
+// Interleaved (position, normal) triangle list for a unit primitive,
+// tessellated with the given shape parameters. Empty for meshes.
+std::vector<float> generatePrimitiveData(PrimitiveType type, int param1, int param2);
+
+// Collapse an interleaved (position, normal) triangle list into unique
+// vertices plus a 0-based index list
+void buildIndexedMesh(const std::vector<float> &triangles,
+                      std::vector<float> &outVertices,
+                      std::vector<uint32_t> &outIndices);
@@ -0,0 +1,274 @@
+#include "rendergraph.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <queue>
+
+RenderGraph::RenderGraph(GLState &glState, RenderTargetPool &pool)
+    : m_glState(glState),
+      m_pool(pool)
+{
+}
+
+void RenderGraph::reset(int width, int height) {
+    m_width = m_renderWidth = width;
+    m_height = m_renderHeight = height;
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_culledCount = 0;
+}
+
+void RenderGraph::setRenderSize(int width, int height) {
+    m_renderWidth = std::clamp(width, 1, m_width);
+    m_renderHeight = std::clamp(height, 1, m_height);
+}
+
+RGResource RenderGraph::createTexture(const std::string &name, const RenderTargetFormat &format,
+                                     RGSize size) {
+    Resource r;
+    r.name = name;
+    r.format = format;
+    r.size = size;
+    m_resources.push_back(r);
+    return (RGResource)(m_resources.size() - 1);
+}
+
+RGResource RenderGraph::importTexture(const std::string &name, GLuint texture, RGSize size) {
+    Resource r;
+    r.name = name;
+    r.size = size;
+    r.imported = true;
+    r.texture = texture;
+    m_resources.push_back(r);
+    return (RGResource)(m_resources.size() - 1);
+}
+
+RGResource RenderGraph::importFramebuffer(const std::string &name, GLuint fbo) {
+    Resource r;
+    r.name = name;
+    r.imported = true;
+    r.size = RGSize::FRAME;
+    r.framebuffer = fbo;
+    m_resources.push_back(r);
+    return (RGResource)(m_resources.size() - 1);
+}
+
+void RenderGraph::addPass(const std::string &name, ResourceList reads, ResourceList writes, Execute execute) {
+    Pass p;
+    p.name = name;
+    p.reads = std::move(reads);
+    p.writes = std::move(writes);
+    p.execute = execute;
+    m_passes.push_back(std::move(p));
+}
+
+bool RenderGraph::compile() {
+    bool sorted = sortPasses();
+    if (!sorted) {
+        std::cerr << "[RenderGraph] passes form a cycle, running them as declared" << std::endl;
+        m_order.clear();
+        for (int i = 0; i < (int)m_passes.size(); i++) m_order.push_back(i);
+    }
+    else {
+        cullPasses();
+    }
+    planLifetimes();
+    return sorted;
+}
+
+bool RenderGraph::sortPasses() {
+    // A resource's writers run in declaration order, and all of them before
+    // any pass that only reads it
+    int n = (int)m_passes.size();
+    FrameVector<FrameVector<int>> writers(m_resources.size());
+    for (int p = 0; p < n; p++) {
+        for (RGResource r : m_passes[p].writes) writers[r].push_back(p);
+    }
+
+    FrameVector<FrameVector<int>> edges(n);
+    FrameVector<int> indegree(n, 0);
+    auto addEdge = [&](int from, int to) {
+        edges[from].push_back(to);
+        indegree[to]++;
+    };
+    for (const FrameVector<int> &w : writers) {
+        for (size_t i = 1; i < w.size(); i++) addEdge(w[i - 1], w[i]);
+    }
+    for (int p = 0; p < n; p++) {
+        for (RGResource r : m_passes[p].reads) {
+            const FrameVector<int> &w = writers[r];
+            if (std::find(w.begin(), w.end(), p) != w.end()) continue; // read-modify-write
+            for (int writer : w) addEdge(writer, p);
+        }
+    }
+
+    // Kahn's algorithm; among ready passes the earliest declared goes first
+    std::priority_queue<int, FrameVector<int>, std::greater<int>> ready;
+    for (int p = 0; p < n; p++) {
+        if (indegree[p] == 0) ready.push(p);
+    }
+    m_order.clear();
+    while (!ready.empty()) {
+        int p = ready.top();
+        ready.pop();
+        m_order.push_back(p);
+        for (int next : edges[p]) {
+            if (--indegree[next] == 0) ready.push(next);
+        }
+    }
+    return (int)m_order.size() == n;
+}
+
+void RenderGraph::cullPasses() {
+    // Reference counts: a resource by its readers, a pass by the resources
+    // it writes. Imported framebuffers are the frame's outputs.
+    for (Resource &r : m_resources) {
+        r.readers = r.framebuffer ? 1 : 0;
+    }
+    for (Pass &p : m_passes) {
+        p.refCount = (int)p.writes.size();
+        for (RGResource r : p.reads) m_resources[r].readers++;
+    }
+
+    ResourceList unread;
+    for (RGResource r = 0; r < m_resources.size(); r++) {
+        if (m_resources[r].readers == 0) unread.push_back(r);
+    }
+
+    // Walk back from every unread resource, dropping writers that are left
+    // with nothing to contribute
+    while (!unread.empty()) {
+        RGResource r = unread.back();
+        unread.pop_back();
+        for (Pass &p : m_passes) {
+            if (p.culled || std::find(p.writes.begin(), p.writes.end(), r) == p.writes.end()) continue;
+            if (--p.refCount > 0) continue;
+
+            p.culled = true;
+            m_culledCount++;
+            for (RGResource read : p.reads) {
+                if (--m_resources[read].readers == 0) unread.push_back(read);
+            }
+        }
+    }
+}
+
+void RenderGraph::planLifetimes() {
+    for (int i = 0; i < (int)m_order.size(); i++) {
+        const Pass &p = m_passes[m_order[i]];
+        if (p.culled) continue;
+        for (const ResourceList *list : {&p.reads, &p.writes}) {
+            for (RGResource r : *list) {
+                Resource &res = m_resources[r];
+                if (res.firstUse < 0) res.firstUse = i;
+                res.lastUse = i;
+            }
+        }
+    }
+}
+
+void RenderGraph::execute() {
+    for (int i = 0; i < (int)m_order.size(); i++) {
+        Pass &p = m_passes[m_order[i]];
+        if (p.culled) continue;
+
+        // Transients get storage right before their first use...
+        for (Resource &r : m_resources) {
+            if (r.imported || r.firstUse != i) continue;
+            glm::ivec2 size = storageSize(r);
+            r.target = m_pool.acquire(r.format, size.x, size.y);
+            r.texture = m_pool.getTexture(r.target);
+        }
+
+        p.execute(*this);
+
+        // ...and hand it back after their last, for the next transient
+        for (Resource &r : m_resources) {
+            if (r.imported || r.lastUse != i) continue;
+            m_pool.release(r.target);
+            r.target = INVALID_RENDER_TARGET;
+        }
+    }
+}
+
+GLuint RenderGraph::getTexture(RGResource resource) const {
+    return m_resources[resource].texture;
+}
+
+void RenderGraph::bindFramebuffer(std::initializer_list<RGResource> colorList, RGResource depthStencil) {
+    const RGResource *colors = colorList.begin();
+    if (colorList.size() == 1 && m_resources[colors[0]].framebuffer) {
+        m_glState.bindFramebuffer(m_resources[colors[0]].framebuffer);
+        m_glState.viewport(0, 0, m_width, m_height);
+        return;
+    }
+    glm::ivec2 viewport = colorList.size() == 0 ? glm::ivec2(m_renderWidth, m_renderHeight)
+                                         : imageSize(m_resources[colors[0]]);
+    m_glState.viewport(0, 0, viewport.x, viewport.y);
+
+    if (m_pool.getGeneration() != m_poolGeneration) {
+        destroy();
+        m_poolGeneration = m_pool.getGeneration();
+    }
+
+    std::array<GLuint, 5> key = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < colorList.size() && i < 4; i++) key[i] = getTexture(colors[i]);
+    if (depthStencil != INVALID_RG_RESOURCE) key[4] = getTexture(depthStencil);
+
+    auto found = m_framebuffers.find(key);
+    if (found != m_framebuffers.end()) {
+        m_glState.bindFramebuffer(found->second);
+        return;
+    }
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    m_glState.bindFramebuffer(fbo);
+    GLenum drawBuffers[4];
+    int count = 0;
+    for (; count < 4 && key[count]; count++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + count, GL_TEXTURE_2D, key[count], 0);
+        drawBuffers[count] = GL_COLOR_ATTACHMENT0 + count;
+    }
+    if (key[4]) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, key[4], 0);
+    }
+    glDrawBuffers(count, drawBuffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "[RenderGraph] framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+    }
+    m_framebuffers.emplace(key, fbo);
+}
+
+glm::vec2 RenderGraph::getUVScale(RGResource resource) const {
+    const Resource &r = m_resources[resource];
+    glm::ivec2 image = imageSize(r);
+    glm::ivec2 storage = storageSize(r);
+    return glm::vec2((float)image.x / RenderTargetPool::bucket(storage.x),
+                     (float)image.y / RenderTargetPool::bucket(storage.y));
+}
+
+glm::ivec2 RenderGraph::imageSize(const Resource &resource) const {
+    switch (resource.size) {
+    case RGSize::FRAME:       return glm::ivec2(m_width, m_height);
+    case RGSize::HALF_RENDER: return glm::ivec2((m_renderWidth + 1) / 2, (m_renderHeight + 1) / 2);
+    default:                  return glm::ivec2(m_renderWidth, m_renderHeight);
+    }
+}
+
+glm::ivec2 RenderGraph::storageSize(const Resource &resource) const {
+    if (resource.size == RGSize::HALF_RENDER) return glm::ivec2((m_width + 1) / 2, (m_height + 1) / 2);
+    return glm::ivec2(m_width, m_height);
+}
+
+void RenderGraph::destroy() {
+    for (auto &[key, fbo] : m_framebuffers) {
+        m_glState.releaseFramebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    m_framebuffers.clear();
+}
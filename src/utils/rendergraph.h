@@ -0,0 +1,140 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "glstate.h"
+#include "rendertargetpool.h"
+#include "framearena.h"
+
+// Resource declared in a RenderGraph; only valid for the frame it was made in
+using RGResource = uint32_t;
+constexpr RGResource INVALID_RG_RESOURCE = ~0u;
+
+// Which size a resource's image has: the (possibly reduced) render size,
+// half of it (rounded up), or the full frame output size
+enum class RGSize { RENDER, HALF_RENDER, FRAME };
+
+// Per-frame description of the renderer's passes. Every pass declares the
+// resources it reads and writes; compile() then
+//  - orders the passes so every read comes after the writes before it,
+//  - drops passes whose results nothing reads (only imported framebuffers
+//    count as final outputs),
+//  - and gives transient textures storage only for the span of passes that
+//    use them. Storage comes from the render-target pool and goes back as
+//    soon as the last reader has run, so transients with disjoint
+//    lifetimes end up sharing the same GL texture.
+// Pass lists and callbacks live in the frame arena, so declaring a frame
+// doesn't touch the heap once the graph's own arrays have grown to size.
+class RenderGraph {
+public:
+    using Execute = FrameFunction<void(RenderGraph &graph)>;
+    using ResourceList = FrameVector<RGResource>;
+
+    RenderGraph(GLState &glState, RenderTargetPool &pool);
+
+    // Start declaring a frame output at width x height. Transients are
+    // allocated for that size; passes render at the render size.
+    void reset(int width, int height);
+    // Render into the bottom-left width x height of the frame-sized targets
+    // (dynamic resolution). Reset to the full frame by reset().
+    void setRenderSize(int width, int height);
+
+    // A texture that only lives inside this frame; frame-sized storage, or
+    // half that for HALF_RENDER
+    RGResource createTexture(const std::string &name, const RenderTargetFormat &format,
+                             RGSize size = RGSize::RENDER);
+    // A texture owned outside the graph (the G-buffer). It should come from
+    // the pool: framebuffers are cached by texture name, and only the pool's
+    // creations and deletions invalidate that cache.
+    RGResource importTexture(const std::string &name, GLuint texture, RGSize size = RGSize::RENDER);
+    // A framebuffer owned outside the graph; writing it is a final output
+    RGResource importFramebuffer(const std::string &name, GLuint fbo);
+
+    void addPass(const std::string &name, ResourceList reads, ResourceList writes, Execute execute);
+
+    // Order, cull and plan storage. Returns false if the passes can't be
+    // ordered (a cycle); they then run in declaration order, unculled.
+    bool compile();
+    // Run the surviving passes
+    void execute();
+
+    // --- For pass callbacks ---
+
+    GLuint getTexture(RGResource resource) const;
+    // Bind a framebuffer with the given color attachments (in order) and
+    // optional depth-stencil, and set the viewport to the first color's
+    // size. A single imported framebuffer is bound as is, with a
+    // frame-sized viewport.
+    void bindFramebuffer(std::initializer_list<RGResource> colors, RGResource depthStencil = INVALID_RG_RESOURCE);
+    // Part of a pooled frame-sized texture covered by the resource's image
+    glm::vec2 getUVScale(RGResource resource) const;
+    int getRenderWidth() const { return m_renderWidth; }
+    int getRenderHeight() const { return m_renderHeight; }
+
+    int getPassCount() const { return (int)m_passes.size(); }
+    int getCulledCount() const { return m_culledCount; }
+
+    // Delete the cached framebuffers; call with the context current
+    void destroy();
+
+private:
+    struct Resource {
+        std::string name;
+        RenderTargetFormat format;
+        RGSize size = RGSize::RENDER;
+        bool imported = false;
+        GLuint texture = 0;      // imported texture, or pooled storage while alive
+        GLuint framebuffer = 0;  // imported framebuffers only
+        RenderTargetHandle target = INVALID_RENDER_TARGET;
+
+        int readers = 0;         // surviving passes that read it (+1 for outputs)
+        int firstUse = -1;       // position in m_order
+        int lastUse = -1;
+    };
+
+    struct Pass {
+        std::string name;
+        ResourceList reads;
+        ResourceList writes;
+        Execute execute;
+        int refCount = 0;        // resources written that someone reads
+        bool culled = false;
+    };
+
+    // Size of the resource's image, and of the storage it is allocated at
+    glm::ivec2 imageSize(const Resource &resource) const;
+    glm::ivec2 storageSize(const Resource &resource) const;
+
+    bool sortPasses();
+    void cullPasses();
+    void planLifetimes();
+
+    GLState &m_glState;
+    RenderTargetPool &m_pool;
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_renderWidth = 0;
+    int m_renderHeight = 0;
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<int> m_order; // pass indices in execution order
+    int m_culledCount = 0;
+
+    // Framebuffers by attachment set: 4 colors + depth-stencil. Rebuilt
+    // whenever the pool creates or deletes a texture, since names recycle.
+    std::map<std::array<GLuint, 5>, GLuint> m_framebuffers;
+    uint32_t m_poolGeneration = 0;
+};
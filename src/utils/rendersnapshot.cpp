@@ -0,0 +1,24 @@
+#include "rendersnapshot.h"
+
+SnapshotExchange::SnapshotExchange() {
+    m_latest.settings = std::make_shared<const Settings>();
+}
+
+void SnapshotExchange::publishSettings(const Settings &settings) {
+    // Copy outside the lock
+    auto published = std::make_shared<const Settings>(settings);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latest.settings = std::move(published);
+    m_latest.settingsRevision++;
+}
+
+void SnapshotExchange::publishScene(std::shared_ptr<const RenderData> scene) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latest.scene = std::move(scene);
+    m_latest.sceneGeneration++;
+}
+
+RenderSnapshot SnapshotExchange::latest() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latest;
+}
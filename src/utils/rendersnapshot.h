@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "settings.h"
+#include "sceneparser.h"
+
+// What the render thread sees of the GUI's state: the settings and the
+// parsed scene. Each part is published as a whole and never modified
+// afterwards, so the render thread can keep using what it took at the start
+// of a frame however the GUI changes meanwhile.
+struct RenderSnapshot {
+    std::shared_ptr<const Settings> settings;
+    std::shared_ptr<const RenderData> scene; // null until a scene is loaded
+    uint64_t settingsRevision = 0;
+    uint64_t sceneGeneration = 0;
+};
+
+// Hands snapshots from the GUI thread to the render thread. The lock is
+// only held to copy a few pointers, never while either side works on them.
+class SnapshotExchange {
+public:
+    SnapshotExchange();
+
+    // GUI thread
+    void publishSettings(const Settings &settings);
+    void publishScene(std::shared_ptr<const RenderData> scene);
+
+    // Render thread: the latest of everything published
+    RenderSnapshot latest() const;
+
+private:
+    mutable std::mutex m_mutex;
+    RenderSnapshot m_latest;
+};
@@ -0,0 +1,123 @@
+#include "rendertargetpool.h"
+
+#include <algorithm>
+#include <iostream>
+
+RenderTargetPool::RenderTargetPool(GLState &glState)
+    : m_glState(glState)
+{
+}
+
+int RenderTargetPool::bucket(int size) {
+    size = std::max(size, 1);
+    return (size + BUCKET_SIZE - 1) / BUCKET_SIZE * BUCKET_SIZE;
+}
+
+RenderTargetHandle RenderTargetPool::acquire(const RenderTargetFormat &format, int width, int height) {
+    int allocWidth = bucket(width);
+    int allocHeight = bucket(height);
+
+    // Reuse the free texture that has been waiting the shortest, so old
+    // ones can age out
+    RenderTargetHandle best = INVALID_RENDER_TARGET;
+    RenderTargetHandle emptySlot = INVALID_RENDER_TARGET;
+    for (RenderTargetHandle h = 0; h < m_targets.size(); h++) {
+        const Target &t = m_targets[h];
+        if (t.texture == 0) {
+            if (emptySlot == INVALID_RENDER_TARGET) emptySlot = h;
+            continue;
+        }
+        if (t.inUse || !(t.format == format)) continue;
+        if (t.allocWidth != allocWidth || t.allocHeight != allocHeight) continue;
+        if (best == INVALID_RENDER_TARGET || t.releasedFrame > m_targets[best].releasedFrame) best = h;
+    }
+
+    if (best != INVALID_RENDER_TARGET) {
+        Target &t = m_targets[best];
+        t.inUse = true;
+        t.width = width;
+        t.height = height;
+        return best;
+    }
+
+    Target t;
+    t.format = format;
+    t.width = width;
+    t.height = height;
+    t.allocWidth = allocWidth;
+    t.allocHeight = allocHeight;
+    t.inUse = true;
+
+    glGenTextures(1, &t.texture);
+    m_generation++;
+    m_glState.bindTexture(0, t.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, allocWidth, allocHeight, 0, format.format, format.type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, format.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, format.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (emptySlot != INVALID_RENDER_TARGET) {
+        m_targets[emptySlot] = t;
+        return emptySlot;
+    }
+    m_targets.push_back(t);
+    return (RenderTargetHandle)(m_targets.size() - 1);
+}
+
+void RenderTargetPool::release(RenderTargetHandle handle) {
+    if (handle >= m_targets.size() || m_targets[handle].texture == 0) return;
+    Target &t = m_targets[handle];
+    t.inUse = false;
+    t.releasedFrame = m_frame;
+}
+
+RenderTargetHandle RenderTargetPool::resize(RenderTargetHandle handle, int width, int height) {
+    Target &t = m_targets[handle];
+    if (bucket(width) == t.allocWidth && bucket(height) == t.allocHeight) {
+        t.width = width;
+        t.height = height;
+        return handle;
+    }
+    RenderTargetFormat format = t.format;
+    release(handle);
+    return acquire(format, width, height);
+}
+
+void RenderTargetPool::endFrame() {
+    m_frame++;
+    for (Target &t : m_targets) {
+        if (t.texture && !t.inUse && m_frame - t.releasedFrame > RETIRE_FRAMES) {
+            deleteTarget(t);
+        }
+    }
+}
+
+void RenderTargetPool::destroy() {
+    for (Target &t : m_targets) {
+        if (t.texture) deleteTarget(t);
+    }
+    m_targets.clear();
+}
+
+void RenderTargetPool::deleteTarget(Target &target) {
+    m_glState.releaseTexture(target.texture);
+    glDeleteTextures(1, &target.texture);
+    m_generation++;
+    target = Target();
+}
+
+glm::vec2 RenderTargetPool::getUVScale(RenderTargetHandle handle) const {
+    const Target &t = m_targets[handle];
+    return glm::vec2((float)t.width / t.allocWidth, (float)t.height / t.allocHeight);
+}
+
+void RenderTargetPool::viewport(RenderTargetHandle handle) {
+    const Target &t = m_targets[handle];
+    m_glState.viewport(0, 0, t.width, t.height);
+}
+
+int RenderTargetPool::getTextureCount() const {
+    return (int)std::count_if(m_targets.begin(), m_targets.end(),
+                              [](const Target &t) { return t.texture != 0; });
+}
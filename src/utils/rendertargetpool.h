@@ -0,0 +1,92 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "glstate.h"
+
+// Texture format of a render target
+struct RenderTargetFormat {
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    GLenum filter;
+
+    bool operator==(const RenderTargetFormat &other) const {
+        return internalFormat == other.internalFormat && format == other.format &&
+               type == other.type && filter == other.filter;
+    }
+};
+
+// Stable reference to a pooled target
+using RenderTargetHandle = uint32_t;
+constexpr RenderTargetHandle INVALID_RENDER_TARGET = ~0u;
+
+// Shared pool of screen-sized textures. Storage is allocated in 64 px size
+// buckets and the requested size is rendered into the bottom-left sub-rect,
+// so resizing within a bucket (dragging a window edge) allocates nothing.
+// Released textures are kept around and handed out again to any request
+// with the same format and bucket; they are only deleted after sitting
+// unused for RETIRE_FRAMES frames.
+class RenderTargetPool {
+public:
+    static constexpr int BUCKET_SIZE = 64;
+    static constexpr int RETIRE_FRAMES = 120;
+
+    RenderTargetPool(GLState &glState);
+
+    // A target of at least width x height; reuses a free texture if possible
+    RenderTargetHandle acquire(const RenderTargetFormat &format, int width, int height);
+    // Hand the texture back to the pool. Invalid handles are ignored.
+    void release(RenderTargetHandle handle);
+    // Change the requested size, keeping the texture if the bucket matches.
+    // Returns the (possibly new) handle; the old one must not be used again.
+    RenderTargetHandle resize(RenderTargetHandle handle, int width, int height);
+
+    // Deletes textures that have been free for too long; call once per frame
+    void endFrame();
+    void destroy();
+
+    GLuint getTexture(RenderTargetHandle handle) const { return m_targets[handle].texture; }
+    int getWidth(RenderTargetHandle handle) const { return m_targets[handle].width; }
+    int getHeight(RenderTargetHandle handle) const { return m_targets[handle].height; }
+
+    // Fraction of the texture covered by the requested size: multiply
+    // normalized coordinates by this when sampling the target
+    glm::vec2 getUVScale(RenderTargetHandle handle) const;
+    // Set the viewport to the target's valid sub-rect
+    void viewport(RenderTargetHandle handle);
+
+    int getTextureCount() const;
+    // Changes whenever a texture is created or deleted; anything caching
+    // texture names (FBO attachments) must be rebuilt when it does
+    uint32_t getGeneration() const { return m_generation; }
+
+    // Storage size for a requested size
+    static int bucket(int size);
+
+private:
+    struct Target {
+        GLuint texture = 0;
+        RenderTargetFormat format;
+        int width = 0;       // requested
+        int height = 0;
+        int allocWidth = 0;  // bucketed storage size
+        int allocHeight = 0;
+        bool inUse = false;
+        uint64_t releasedFrame = 0;
+    };
+
+    void deleteTarget(Target &target);
+
+    GLState &m_glState;
+    std::vector<Target> m_targets; // texture == 0 marks an unused slot
+    uint64_t m_frame = 0;
+    uint32_t m_generation = 0;
+};
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
 #include <vector>
 #include <string>
 
@@ -160,10 +164,51 @@ struct SceneTransformation {
     glm::mat4 matrix;    // Only applicable when transforming by a custom matrix. This is that custom matrix.
 };
 
+// A run of consecutive entries in one of SceneGraph's arrays
+struct SceneRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
 // Struct which represents a node in the scene graph/tree, to be parsed by the student's `SceneParser`.
+// Everything it holds lives in the SceneGraph's arrays; these are ranges of them.
 struct SceneNode {
-    std::vector<SceneTransformation*> transformations; // Note the order of transformations described in lab 5
-    std::vector<ScenePrimitive*> primitives;
-    std::vector<SceneLight*> lights;
-    std::vector<SceneNode*> children;
+    SceneRange transformations; // Note the order of transformations described in lab 5
+    SceneRange primitives;
+    SceneRange lights;
+    SceneRange children; // of SceneGraph::children, which holds node indices
+};
+
+// The whole scene graph as a few flat arrays, all allocated from one
+// monotonic arena: building it takes a handful of big blocks, and tearing it
+// down frees them together. Node 0 is the root; template groups are nodes
+// listed as a child of every group that uses them.
+struct SceneGraph {
+    // initialSize: first arena block, in bytes
+    explicit SceneGraph(size_t initialSize)
+        : arena(std::max<size_t>(initialSize, 1)) {}
+
+    SceneGraph(const SceneGraph&) = delete;
+    SceneGraph &operator=(const SceneGraph&) = delete;
+
+    const SceneNode &getRoot() const { return nodes[0]; }
+    std::span<const SceneTransformation> getTransformations(const SceneNode &node) const {
+        return {transformations.data() + node.transformations.first, node.transformations.count};
+    }
+    std::span<const ScenePrimitive> getPrimitives(const SceneNode &node) const {
+        return {primitives.data() + node.primitives.first, node.primitives.count};
+    }
+    std::span<const SceneLight> getLights(const SceneNode &node) const {
+        return {lights.data() + node.lights.first, node.lights.count};
+    }
+    std::span<const uint32_t> getChildren(const SceneNode &node) const {
+        return {children.data() + node.children.first, node.children.count};
+    }
+
+    std::pmr::monotonic_buffer_resource arena; // declared before what it backs
+    std::pmr::vector<SceneNode> nodes{&arena};
+    std::pmr::vector<SceneTransformation> transformations{&arena};
+    std::pmr::vector<ScenePrimitive> primitives{&arena};
+    std::pmr::vector<SceneLight> lights{&arena};
+    std::pmr::vector<uint32_t> children{&arena};
 };
@@ -4,55 +4,132 @@
 #include "glm/gtc/type_ptr.hpp"
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <iterator>
 
 #include <QFile>
-#include <QJsonArray>
 
-#define ERROR_AT(e) "error at line " << e.lineNumber() << " col " << e.columnNumber() << ": "
-#define PARSE_ERROR(e) std::cout << ERROR_AT(e) << "could not parse <" << e.tagName().toStdString() \
-                                 << ">" << std::endl
-#define UNSUPPORTED_ELEMENT(e) std::cout << ERROR_AT(e) << "unsupported element <" \
-                                         << e.tagName().toStdString() << ">" << std::endl;
+#include "jobsystem.h"
 
-// Students, please ignore this file.
-ScenefileReader::ScenefileReader(const std::string &name) {
-    file_name = name;
+#define ERROR_AT(line, column) "error at line " << line << " col " << column << ": "
 
-    memset(&m_cameraData, 0, sizeof(SceneCameraData));
-    memset(&m_globalData, 0, sizeof(SceneGlobalData));
+namespace {
 
-    m_root = new SceneNode;
+constexpr size_t NO_OFFSET = SIZE_MAX;
+// Marks template nodes in the graphs of parseTopLevelGroups' workers
+constexpr uint32_t TEMPLATE_NODE = 1u << 31;
 
-    m_templates.clear();
-    m_nodes.clear();
+// These read the value at the cursor; what names it in error messages
 
-    m_nodes.push_back(m_root);
+bool readFloat(JsonCursor &json, float &out, const char *what) {
+    if (json.peek() != JsonCursor::Type::NUMBER) {
+        return json.fail(std::string(what) + " must be a floating-point value");
+    }
+    double value;
+    if (!json.readNumber(value)) return false;
+    out = (float)value;
+    return true;
 }
 
-ScenefileReader::~ScenefileReader() {
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++)
-        {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++)
-        {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
+// An array of exactly count numbers
+bool readFloats(JsonCursor &json, float *out, size_t count, const char *what) {
+    size_t at = json.mark();
+    if (json.peek() != JsonCursor::Type::ARRAY) {
+        return json.fail(std::string(what) + " must be of type array");
+    }
+    auto wrongSize = [&] {
+        return json.fail(at, std::string(what) + " must have " + std::to_string(count) + " elements");
+    };
+    size_t read = 0;
+    bool ok = json.readArray([&](size_t index) {
+        if (index >= count) return wrongSize();
+        if (json.peek() != JsonCursor::Type::NUMBER) {
+            return json.fail(std::string(what) + " must contain floating-point values");
+        }
+        double value;
+        if (!json.readNumber(value)) return false;
+        out[read++] = (float)value;
+        return true;
+    });
+    if (!ok) return false;
+    return read == count || wrongSize();
+}
+
+bool readVec3(JsonCursor &json, glm::vec3 &out, const char *what) {
+    return readFloats(json, glm::value_ptr(out), 3, what);
+}
+
+// Rows in the file, stored column-wise
+bool readMatrix(JsonCursor &json, glm::mat4 &out) {
+    size_t at = json.mark();
+    if (json.peek() != JsonCursor::Type::ARRAY) {
+        return json.fail("group matrix must be of type array of array");
+    }
+    float *matrixPtr = glm::value_ptr(out);
+    size_t rows = 0;
+    bool ok = json.readArray([&](size_t rowIndex) {
+        if (rowIndex >= 4) return json.fail(at, "group matrix must be 4x4");
+        if (json.peek() != JsonCursor::Type::ARRAY) {
+            return json.fail("group matrix must be of type array of array");
+        }
+        float row[4];
+        if (!readFloats(json, row, 4, "group matrix row")) return false;
+        for (int colIndex = 0; colIndex < 4; colIndex++) {
+            matrixPtr[colIndex * 4 + rowIndex] = row[colIndex];
+        }
+        rows++;
+        return true;
+    });
+    if (!ok) return false;
+    return rows == 4 || json.fail(at, "group matrix must be 4x4");
+}
+
+bool readString(JsonCursor &json, std::string_view &out, const char *what) {
+    if (json.peek() != JsonCursor::Type::STRING) {
+        return json.fail(std::string(what) + " must be of type string");
     }
+    return json.readString(out);
+}
+
+// Texture repeats fall back to 1 when they aren't numbers
+bool readOptionalFloat(JsonCursor &json, float &out) {
+    if (json.peek() != JsonCursor::Type::NUMBER) return json.skipValue();
+    return readFloat(json, out, "");
+}
+
+bool unknownField(JsonCursor &json, std::string_view field, const char *object) {
+    return json.fail(json.getFieldOffset(), "unknown field \"" + std::string(field) + "\" on " + object + " object");
+}
+
+bool missingField(JsonCursor &json, size_t objectOffset, const char *field, const char *object) {
+    return json.fail(objectOffset, std::string("missing required field \"") + field + "\" on " + object + " object");
+}
+
+}
+
+// What parseGroupData leaves to its caller
+struct ScenefileReader::GroupFields {
+    bool hasName = false;
+    std::string name;
+    size_t groups = NO_OFFSET; // offset of the "groups" array, read later
+};
+
+// Students, please ignore this file.
+ScenefileReader::ScenefileReader(const std::string &name) {
+    file_name = name;
+
+    memset(&m_cameraData, 0, sizeof(SceneCameraData));
+    memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
-    m_nodes.clear();
     m_templates.clear();
 }
 
+// The scene graph's arena goes with it
+ScenefileReader::~ScenefileReader() = default;
+
 SceneGlobalData ScenefileReader::getGlobalData() const {
     return m_globalData;
 }
@@ -61,311 +138,232 @@ SceneCameraData ScenefileReader::getCameraData() const {
     return m_cameraData;
 }
 
-SceneNode *ScenefileReader::getRootNode() const {
-    return m_root;
+const SceneGraph &ScenefileReader::getSceneGraph() const {
+    return *m_graph;
+}
+
+uint32_t ScenefileReader::addNode() {
+    m_graph->nodes.emplace_back();
+    return (uint32_t)m_graph->nodes.size() - 1;
+}
+
+// Only valid while nothing was added after the node's own parts
+void ScenefileReader::removeLastNode() {
+    SceneGraph &graph = *m_graph;
+    const SceneNode &node = graph.nodes.back();
+    graph.transformations.resize(node.transformations.first);
+    graph.lights.resize(node.lights.first);
+    graph.primitives.resize(node.primitives.first);
+    graph.nodes.pop_back();
 }
 
 // This is where it all goes down...
 bool ScenefileReader::readJSON() {
-    // Read the file
+    // Map the file rather than read it: nothing is copied, and only the
+    // pages being parsed have to be resident
     QFile file(file_name.c_str());
     if (!file.open(QFile::ReadOnly)) {
         std::cout << "could not open " << file_name << std::endl;
         return false;
     }
-
-    // Load the JSON document
-    QByteArray fileContents = file.readAll();
-    QJsonParseError jsonError;
-    QJsonDocument doc = QJsonDocument::fromJson(fileContents, &jsonError);
-    if (doc.isNull()) {
+    qint64 size = file.size();
+    const char *data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    QByteArray fileContents;
+    if (!data) {
+        // Not mappable (or empty): read it in after all
+        fileContents = file.readAll();
+        data = fileContents.constData();
+        size = fileContents.size();
+    }
+
+    m_basePath = std::filesystem::path(file_name).parent_path().parent_path().string();
+    // Parsed, the scene takes up about as much as its text; starting the
+    // arena at that size leaves it a block or two to grow by
+    m_graph = std::make_unique<SceneGraph>(size);
+    addNode(); // the root
+
+    m_text = std::string_view(data, size);
+    JsonCursor json(data, size);
+    if (!parseScenefile(json)) {
+        int line, column;
+        json.getErrorLocation(line, column);
         std::cout << "could not parse " << file_name << std::endl;
-        std::cout << "parse error at line " << jsonError.offset << ": "
-                  << jsonError.errorString().toStdString() << std::endl;
-        return false;
-    }
-    file.close();
-
-    if (!doc.isObject()) {
-        std::cout << "document is not an object" << std::endl;
-        return false;
-    }
-
-    // Get the root element
-    QJsonObject scenefile = doc.object();
-
-    if (!scenefile.contains("globalData")) {
-        std::cout << "missing required field \"globalData\" on root object" << std::endl;
-        return false;
-    }
-    if (!scenefile.contains("cameraData")) {
-        std::cout << "missing required field \"cameraData\" on root object" << std::endl;
-        return false;
-    }
-
-    QStringList requiredFields = {"globalData", "cameraData"};
-    QStringList optionalFields = {"name", "groups", "templateGroups"};
-    // If other fields are present, raise an error
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : scenefile.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on root object" << std::endl;
-            return false;
-        }
-    }
-
-    // Parse the global data
-    if (!parseGlobalData(scenefile["globalData"].toObject())) {
-        std::cout << "could not parse \"globalData\"" << std::endl;
-        return false;
-    }
-
-    // Parse the camera data
-    if (!parseCameraData(scenefile["cameraData"].toObject())) {
-        std::cout << "could not parse \"cameraData\"" << std::endl;
+        std::cout << ERROR_AT(line, column) << json.getError() << std::endl;
         return false;
     }
 
-    // Parse the template groups
-    if (scenefile.contains("templateGroups")) {
-        if (!parseTemplateGroups(scenefile["templateGroups"])) {
-            return false;
-        }
-    }
-
-    // Parse the groups
-    if (scenefile.contains("groups")) {
-        if (!parseGroups(scenefile["groups"], m_root)) {
-            return false;
-        }
-    }
-
     std::cout << "Finished reading " << file_name << std::endl;
     return true;
 }
 
 /**
- * Parse a globalData field and fill in m_globalData.
+ * Parse the root object.
  */
-bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
-    QStringList requiredFields = {"ambientCoeff", "diffuseCoeff", "specularCoeff"};
-    QStringList optionalFields = {"transparentCoeff"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : globalData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on globalData object" << std::endl;
-            return false;
-        }
-    }
-    for (auto field : requiredFields) {
-        if (!globalData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on globalData object" << std::endl;
-            return false;
-        }
-    }
-
-    // Parse the global data
-    if (globalData["ambientCoeff"].isDouble()) {
-        m_globalData.ka = globalData["ambientCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData ambientCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData["diffuseCoeff"].isDouble()) {
-        m_globalData.kd = globalData["diffuseCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData diffuseCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData["specularCoeff"].isDouble()) {
-        m_globalData.ks = globalData["specularCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData specularCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData.contains("transparentCoeff")) {
-        if (globalData["transparentCoeff"].isDouble()) {
-            m_globalData.kt = globalData["transparentCoeff"].toDouble();
-        }
-        else {
-            std::cout << "globalData transparentCoeff must be a floating-point value" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseScenefile(JsonCursor &json) {
+    size_t start = json.mark();
+    if (json.peek() != JsonCursor::Type::OBJECT) {
+        return json.fail("document is not an object");
+    }
+
+    bool hasGlobalData = false;
+    bool hasCameraData = false;
+    bool hasTemplateGroups = false;
+    size_t groups = NO_OFFSET;
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "globalData") {
+            hasGlobalData = true;
+            return parseGlobalData(json);
+        }
+        if (field == "cameraData") {
+            hasCameraData = true;
+            return parseCameraData(json);
+        }
+        if (field == "templateGroups") {
+            hasTemplateGroups = true;
+            return parseTemplateGroups(json);
+        }
+        if (field == "groups") {
+            // Groups may use any template, so unless those have been read
+            // they wait until the end
+            if (hasTemplateGroups) return parseGroups(json, 0);
+            groups = json.mark();
+            return json.skipValue();
+        }
+        if (field == "name") {
+            return json.skipValue();
+        }
+        return unknownField(json, field, "root");
+    });
+    if (!ok) return false;
+
+    if (!hasGlobalData) return missingField(json, start, "globalData", "root");
+    if (!hasCameraData) return missingField(json, start, "cameraData", "root");
+    if (!json.atEnd()) return json.fail("unexpected data after the root object");
+
+    if (groups != NO_OFFSET) {
+        json.seek(groups);
+        return parseGroups(json, 0);
     }
+    return true;
+}
 
+/**
+ * Parse a globalData field and fill in m_globalData.
+ */
+bool ScenefileReader::parseGlobalData(JsonCursor &json) {
+    size_t start = json.mark();
+    bool hasAmbient = false;
+    bool hasDiffuse = false;
+    bool hasSpecular = false;
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "ambientCoeff") {
+            hasAmbient = true;
+            return readFloat(json, m_globalData.ka, "globalData ambientCoeff");
+        }
+        if (field == "diffuseCoeff") {
+            hasDiffuse = true;
+            return readFloat(json, m_globalData.kd, "globalData diffuseCoeff");
+        }
+        if (field == "specularCoeff") {
+            hasSpecular = true;
+            return readFloat(json, m_globalData.ks, "globalData specularCoeff");
+        }
+        if (field == "transparentCoeff") {
+            return readFloat(json, m_globalData.kt, "globalData transparentCoeff");
+        }
+        return unknownField(json, field, "globalData");
+    });
+    if (!ok) return false;
+
+    if (!hasAmbient) return missingField(json, start, "ambientCoeff", "globalData");
+    if (!hasDiffuse) return missingField(json, start, "diffuseCoeff", "globalData");
+    if (!hasSpecular) return missingField(json, start, "specularCoeff", "globalData");
     return true;
 }
 
 /**
  * Parse a Light and add a new CS123SceneLightData to m_lights.
  */
-bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *node) {
-    QStringList requiredFields = {"type", "color"};
-    QStringList optionalFields = {"name", "attenuationCoeff", "direction", "penumbra", "angle"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : lightData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on light object" << std::endl;
-            return false;
-        }
-    }
-    for (auto &field : requiredFields) {
-        if (!lightData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on light object" << std::endl;
-            return false;
-        }
-    }
+bool ScenefileReader::parseLightData(JsonCursor &json) {
+    size_t start = json.mark();
 
     // Create a default light
-    SceneLight *light = new SceneLight();
+    // (parseGroupData gives the node the lights it added)
+    SceneLight *light = &m_graph->lights.emplace_back();
     memset(light, 0, sizeof(SceneLight));
-    node->lights.push_back(light);
 
     light->dir = glm::vec4(0.f, 0.f, 0.f, 0.f);
     light->function = glm::vec3(1, 0, 0);
 
-    // parse the color
-    if (!lightData["color"].isArray()) {
-        std::cout << "light color must be of type array" << std::endl;
-        return false;
-    }
-    QJsonArray colorArray = lightData["color"].toArray();
-    if (colorArray.size() != 3) {
-        std::cout << "light color must be of size 3" << std::endl;
-        return false;
-    }
-    if (!colorArray[0].isDouble() || !colorArray[1].isDouble() || !colorArray[2].isDouble()) {
-        std::cout << "light color must contain floating-point values" << std::endl;
-        return false;
-    }
-    light->color.r = colorArray[0].toDouble();
-    light->color.g = colorArray[1].toDouble();
-    light->color.b = colorArray[2].toDouble();
-
-    // parse the type
-    if (!lightData["type"].isString()) {
-        std::cout << "light type must be of type string" << std::endl;
-        return false;
-    }
-    std::string lightType = lightData["type"].toString().toStdString();
-
-    // parse directional light
-    if (lightType == "directional") {
-        light->type = LightType::LIGHT_DIRECTIONAL;
-
-        // parse direction
-        if (!lightData.contains("direction")) {
-            std::cout << "directional light must contain field \"direction\"" << std::endl;
-            return false;
-        }
-        if (!lightData["direction"].isArray()) {
-            std::cout << "directional light direction must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "directional light direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "directional light direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
-    }
-    else if (lightType == "point") {
-        light->type = LightType::LIGHT_POINT;
-
-        // parse the attenuation coefficient
-        if (!lightData.contains("attenuationCoeff")) {
-            std::cout << "point light must contain field \"attenuationCoeff\"" << std::endl;
-            return false;
-        }
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "point light attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "point light attenuationCoeff must be of size 3" << std::endl;
-            return false;
-        }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "ppoint light attenuationCoeff must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
-    }
-    else if (lightType == "spot") {
-        QStringList pointRequiredFields = {"direction", "penumbra", "angle", "attenuationCoeff"};
-        for (auto &field : pointRequiredFields) {
-            if (!lightData.contains(field)) {
-                std::cout << "missing required field \"" << field.toStdString() << "\" on spotlight object" << std::endl;
-                return false;
-            }
-        }
-        light->type = LightType::LIGHT_SPOT;
-
-        // parse direction
-        if (!lightData["direction"].isArray()) {
-            std::cout << "spotlight direction must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "spotlight direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
-
-        // parse attenuation coefficient
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "spotlight attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "spotlight attenuationCoeff must be of size 3" << std::endl;
-            return false;
-        }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
-
-        // parse penumbra
-        if (!lightData["penumbra"].isDouble()) {
-            std::cout << "spotlight penumbra must be of type float" << std::endl;
-            return false;
-        }
-        light->penumbra = lightData["penumbra"].toDouble() * M_PI / 180.f;
-
-        // parse angle
-        if (!lightData["angle"].isDouble()) {
-            std::cout << "spotlight angle must be of type float" << std::endl;
-            return false;
-        }
-        light->angle = lightData["angle"].toDouble() * M_PI / 180.f;
-    }
-    else {
-        std::cout << "unknown light type \"" << lightType << "\"" << std::endl;
-        return false;
+    // Which fields apply depends on the type, which may come last
+    bool hasType = false, hasColor = false, hasDirection = false;
+    bool hasAttenuation = false, hasPenumbra = false, hasAngle = false;
+    glm::vec3 color, direction, attenuation;
+    float penumbra = 0.f, angle = 0.f;
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "type") {
+            hasType = true;
+            size_t at = json.mark();
+            std::string_view lightType;
+            if (!readString(json, lightType, "light type")) return false;
+            if (lightType == "directional") light->type = LightType::LIGHT_DIRECTIONAL;
+            else if (lightType == "point") light->type = LightType::LIGHT_POINT;
+            else if (lightType == "spot") light->type = LightType::LIGHT_SPOT;
+            else return json.fail(at, "unknown light type \"" + std::string(lightType) + "\"");
+            return true;
+        }
+        if (field == "color") {
+            hasColor = true;
+            return readVec3(json, color, "light color");
+        }
+        if (field == "direction") {
+            hasDirection = true;
+            return readVec3(json, direction, "light direction");
+        }
+        if (field == "attenuationCoeff") {
+            hasAttenuation = true;
+            return readVec3(json, attenuation, "light attenuationCoeff");
+        }
+        if (field == "penumbra") {
+            hasPenumbra = true;
+            return readFloat(json, penumbra, "spotlight penumbra");
+        }
+        if (field == "angle") {
+            hasAngle = true;
+            return readFloat(json, angle, "spotlight angle");
+        }
+        if (field == "name") {
+            return json.skipValue();
+        }
+        return unknownField(json, field, "light");
+    });
+    if (!ok) return false;
+
+    if (!hasType) return missingField(json, start, "type", "light");
+    if (!hasColor) return missingField(json, start, "color", "light");
+    light->color.r = color.r;
+    light->color.g = color.g;
+    light->color.b = color.b;
+
+    switch (light->type) {
+    case LightType::LIGHT_DIRECTIONAL:
+        if (!hasDirection) return json.fail(start, "directional light must contain field \"direction\"");
+        light->dir = glm::vec4(direction, 0.f);
+        break;
+    case LightType::LIGHT_POINT:
+        if (!hasAttenuation) return json.fail(start, "point light must contain field \"attenuationCoeff\"");
+        light->function = attenuation;
+        break;
+    case LightType::LIGHT_SPOT:
+        if (!hasDirection) return missingField(json, start, "direction", "spotlight");
+        if (!hasPenumbra) return missingField(json, start, "penumbra", "spotlight");
+        if (!hasAngle) return missingField(json, start, "angle", "spotlight");
+        if (!hasAttenuation) return missingField(json, start, "attenuationCoeff", "spotlight");
+        light->dir = glm::vec4(direction, 0.f);
+        light->function = attenuation;
+        light->penumbra = penumbra * M_PI / 180.f;
+        light->angle = angle * M_PI / 180.f;
+        break;
     }
 
     return true;
@@ -374,433 +372,412 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
 /**
  * Parse cameraData and fill in m_cameraData.
  */
-bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
-    QStringList requiredFields = {"position", "up", "heightAngle"};
-    QStringList optionalFields = {"aperture", "focalLength", "look", "focus"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : cameradata.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
-            return false;
-        }
-    }
-    for (auto &field : requiredFields) {
-        if (!cameradata.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
-            return false;
-        }
-    }
+bool ScenefileReader::parseCameraData(JsonCursor &json) {
+    size_t start = json.mark();
+    bool hasPosition = false, hasUp = false, hasHeightAngle = false;
+    bool hasLook = false, hasFocus = false;
+    glm::vec3 position, up, look;
+    float heightAngle = 0.f;
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "position") {
+            hasPosition = true;
+            return readVec3(json, position, "cameraData position");
+        }
+        if (field == "up") {
+            hasUp = true;
+            return readVec3(json, up, "cameraData up");
+        }
+        if (field == "heightAngle") {
+            hasHeightAngle = true;
+            return readFloat(json, heightAngle, "cameraData heightAngle");
+        }
+        if (field == "aperture") {
+            return readFloat(json, m_cameraData.aperture, "cameraData aperture");
+        }
+        if (field == "focalLength") {
+            return readFloat(json, m_cameraData.focalLength, "cameraData focalLength");
+        }
+        // if the focus is specified, we will convert it to a look vector later
+        if (field == "look") {
+            hasLook = true;
+            return readVec3(json, look, "cameraData look");
+        }
+        if (field == "focus") {
+            hasFocus = true;
+            return readVec3(json, look, "cameraData focus");
+        }
+        return unknownField(json, field, "cameraData");
+    });
+    if (!ok) return false;
+
+    if (!hasPosition) return missingField(json, start, "position", "cameraData");
+    if (!hasUp) return missingField(json, start, "up", "cameraData");
+    if (!hasHeightAngle) return missingField(json, start, "heightAngle", "cameraData");
 
     // Must have either look or focus, but not both
-    if (cameradata.contains("look") && cameradata.contains("focus")) {
-        std::cout << "cameraData cannot contain both \"look\" and \"focus\"" << std::endl;
-        return false;
+    if (hasLook && hasFocus) {
+        return json.fail(start, "cameraData cannot contain both \"look\" and \"focus\"");
     }
 
-    // Parse the camera data
-    if (cameradata["position"].isArray()) {
-        QJsonArray position = cameradata["position"].toArray();
-        if (position.size() != 3) {
-            std::cout << "cameraData position must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!position[0].isDouble() || !position[1].isDouble() || !position[2].isDouble()) {
-            std::cout << "cameraData position must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.pos.x = position[0].toDouble();
-        m_cameraData.pos.y = position[1].toDouble();
-        m_cameraData.pos.z = position[2].toDouble();
-        m_cameraData.pos.w = 1.f;
-    }
-    else {
-        std::cout << "cameraData position must be an array" << std::endl;
-        return false;
-    }
+    m_cameraData.pos = glm::vec4(position, 1.f);
+    m_cameraData.up = glm::vec4(up, 0.f);
+    m_cameraData.heightAngle = heightAngle * M_PI / 180.f;
 
-    if (cameradata["up"].isArray()) {
-        QJsonArray up = cameradata["up"].toArray();
-        if (up.size() != 3) {
-            std::cout << "cameraData up must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!up[0].isDouble() || !up[1].isDouble() || !up[2].isDouble()) {
-            std::cout << "cameraData up must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.up.x = up[0].toDouble();
-        m_cameraData.up.y = up[1].toDouble();
-        m_cameraData.up.z = up[2].toDouble();
-        m_cameraData.up.w = 0.f;
-    }
-    else {
-        std::cout << "cameraData up must be an array" << std::endl;
-        return false;
+    // Convert the focus point into a look vector from the camera position
+    // to that focus point.
+    if (hasFocus) {
+        look -= position;
     }
-
-    if (cameradata["heightAngle"].isDouble()) {
-        m_cameraData.heightAngle = cameradata["heightAngle"].toDouble() * M_PI / 180.f;
-    }
-    else {
-        std::cout << "cameraData heightAngle must be a floating-point value" << std::endl;
-        return false;
-    }
-
-    if (cameradata.contains("aperture")) {
-        if (cameradata["aperture"].isDouble()) {
-            m_cameraData.aperture = cameradata["aperture"].toDouble();
-        }
-        else {
-            std::cout << "cameraData aperture must be a floating-point value" << std::endl;
-            return false;
-        }
-    }
-
-    if (cameradata.contains("focalLength")) {
-        if (cameradata["focalLength"].isDouble()) {
-            m_cameraData.focalLength = cameradata["focalLength"].toDouble();
-        }
-        else {
-            std::cout << "cameraData focalLength must be a floating-point value" << std::endl;
-            return false;
-        }
-    }
-
-    // Parse the look or focus
-    // if the focus is specified, we will convert it to a look vector later
-    if (cameradata.contains("look")) {
-        if (cameradata["look"].isArray()) {
-            QJsonArray look = cameradata["look"].toArray();
-            if (look.size() != 3) {
-                std::cout << "cameraData look must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!look[0].isDouble() || !look[1].isDouble() || !look[2].isDouble()) {
-                std::cout << "cameraData look must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = look[0].toDouble();
-            m_cameraData.look.y = look[1].toDouble();
-            m_cameraData.look.z = look[2].toDouble();
-            m_cameraData.look.w = 0.f;
-        }
-        else {
-            std::cout << "cameraData look must be an array" << std::endl;
-            return false;
-        }
-    }
-    else if (cameradata.contains("focus")) {
-        if (cameradata["focus"].isArray()) {
-            QJsonArray focus = cameradata["focus"].toArray();
-            if (focus.size() != 3) {
-                std::cout << "cameraData focus must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!focus[0].isDouble() || !focus[1].isDouble() || !focus[2].isDouble()) {
-                std::cout << "cameraData focus must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = focus[0].toDouble();
-            m_cameraData.look.y = focus[1].toDouble();
-            m_cameraData.look.z = focus[2].toDouble();
-            m_cameraData.look.w = 1.f;
-        }
-        else {
-            std::cout << "cameraData focus must be an array" << std::endl;
-            return false;
-        }
-    }
-
-    // Convert the focus point (stored in the look vector) into a
-    // look vector from the camera position to that focus point.
-    if (cameradata.contains("focus")) {
-        m_cameraData.look -= m_cameraData.pos;
+    if (hasLook || hasFocus) {
+        m_cameraData.look = glm::vec4(look, 0.f);
     }
 
     return true;
 }
 
-bool ScenefileReader::parseTemplateGroups(const QJsonValue &templateGroups) {
-    if (!templateGroups.isArray()) {
-        std::cout << "templateGroups must be an array" << std::endl;
-        return false;
+bool ScenefileReader::parseTemplateGroups(JsonCursor &json) {
+    if (json.peek() != JsonCursor::Type::ARRAY) {
+        return json.fail("templateGroups must be an array");
     }
 
-    QJsonArray templateGroupsArray = templateGroups.toArray();
-    for (auto templateGroup : templateGroupsArray) {
-        if (!templateGroup.isObject()) {
-            std::cout << "templateGroup items must be of type object" << std::endl;
-            return false;
-        }
-
-        if (!parseTemplateGroupData(templateGroup.toObject())) {
-            return false;
+    return json.readArray([&](size_t) {
+        if (json.peek() != JsonCursor::Type::OBJECT) {
+            return json.fail("templateGroup items must be of type object");
         }
-    }
-
-    return true;
+        return parseTemplateGroupData(json);
+    });
 }
 
-bool ScenefileReader::parseTemplateGroupData(const QJsonObject &templateGroup) {
-    QStringList requiredFields = {"name"};
-    QStringList optionalFields = {"translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : templateGroup.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseTemplateGroupData(JsonCursor &json) {
+    size_t start = json.mark();
+    uint32_t templateNode = addNode();
+    GroupFields fields;
+    if (!parseGroupData(json, templateNode, "templateGroup", fields)) {
+        return false;
+    }
+    if (!fields.hasName) {
+        return missingField(json, start, "name", "templateGroup");
     }
 
-    for (auto &field : requiredFields) {
-        if (!templateGroup.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
+    // Its own groups are read before it's registered, so they can't use it
+    if (fields.groups != NO_OFFSET) {
+        size_t end = json.mark();
+        json.seek(fields.groups);
+        if (!parseGroups(json, templateNode)) {
             return false;
         }
+        json.seek(end);
     }
 
-    if (!templateGroup["name"].isString()) {
-        std::cout << "templateGroup name must be a string" << std::endl;
-    }
-    if (m_templates.contains(templateGroup["name"].toString().toStdString())) {
-        std::cout << "templateGroups cannot have the same" << std::endl;
+    if (m_templates.contains(fields.name)) {
+        std::cout << "templateGroups cannot have the same name" << std::endl;
     }
-
-    SceneNode *templateNode = new SceneNode;
-    m_nodes.push_back(templateNode);
-    m_templates[templateGroup["name"].toString().toStdString()] = templateNode;
-
-    return parseGroupData(templateGroup, templateNode);
+    m_templates[fields.name] = templateNode;
+    return true;
 }
 
 /**
- * Parse a group object and create a new CS123SceneNode in m_nodes.
- * NAME OF NODE CANNOT REFERENCE TEMPLATE NODE
+ * Parse a group object into node. Its groups are only located: the caller
+ * reads them once the node's siblings are in place.
  */
-bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node) {
-    QStringList optionalFields = {"name", "translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = optionalFields;
-    for (auto &field : object.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on group object" << std::endl;
-            return false;
-        }
-    }
-
-    // parse translation if defined
-    if (object.contains("translate")) {
-        if (!object["translate"].isArray()) {
-            std::cout << "group translate must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray translateArray = object["translate"].toArray();
-        if (translateArray.size() != 3) {
-            std::cout << "group translate must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!translateArray[0].isDouble() || !translateArray[1].isDouble() || !translateArray[2].isDouble()) {
-            std::cout << "group translate must contain floating-point values" << std::endl;
-            return false;
+bool ScenefileReader::parseGroupData(JsonCursor &json, uint32_t node, const char *objectName, GroupFields &fields) {
+    // Applied in this order, whichever order the file lists them in
+    enum { TRANSLATE, ROTATE, SCALE, MATRIX, TRANSFORMATION_KINDS };
+    SceneTransformation transformations[TRANSFORMATION_KINDS] = {};
+    bool hasTransformation[TRANSFORMATION_KINDS] = {};
+
+    // Lights and primitives are added as they're read, before any of the
+    // children's, so each set is one range
+    uint32_t firstLight = (uint32_t)m_graph->lights.size();
+    uint32_t firstPrimitive = (uint32_t)m_graph->primitives.size();
+
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "name") {
+            std::string_view name;
+            if (!readString(json, name, "group name")) return false;
+            fields.hasName = true;
+            fields.name = name;
+            return true;
+        }
+
+        // parse translation if defined
+        if (field == "translate") {
+            SceneTransformation &translation = transformations[TRANSLATE];
+            hasTransformation[TRANSLATE] = true;
+            translation.type = TransformationType::TRANSFORMATION_TRANSLATE;
+            return readVec3(json, translation.translate, "group translate");
+        }
+
+        // parse rotation if defined
+        if (field == "rotate") {
+            SceneTransformation &rotation = transformations[ROTATE];
+            hasTransformation[ROTATE] = true;
+            rotation.type = TransformationType::TRANSFORMATION_ROTATE;
+            float rotate[4];
+            if (!readFloats(json, rotate, 4, "group rotate")) return false;
+            rotation.rotate = glm::vec3(rotate[0], rotate[1], rotate[2]);
+            rotation.angle = rotate[3] * M_PI / 180.f;
+            return true;
+        }
+
+        // parse scale if defined
+        if (field == "scale") {
+            SceneTransformation &scale = transformations[SCALE];
+            hasTransformation[SCALE] = true;
+            scale.type = TransformationType::TRANSFORMATION_SCALE;
+            return readVec3(json, scale.scale, "group scale");
+        }
+
+        // parse matrix if defined
+        if (field == "matrix") {
+            SceneTransformation &matrixTransformation = transformations[MATRIX];
+            hasTransformation[MATRIX] = true;
+            matrixTransformation.type = TransformationType::TRANSFORMATION_MATRIX;
+            return readMatrix(json, matrixTransformation.matrix);
+        }
+
+        // parse lights if any
+        if (field == "lights") {
+            if (json.peek() != JsonCursor::Type::ARRAY) {
+                return json.fail("group lights must be of type array");
+            }
+            return json.readArray([&](size_t) {
+                if (json.peek() != JsonCursor::Type::OBJECT) {
+                    return json.fail("light must be of type object");
+                }
+                return parseLightData(json);
+            });
         }
 
-        SceneTransformation *translation = new SceneTransformation();
-        translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
-        translation->translate.x = translateArray[0].toDouble();
-        translation->translate.y = translateArray[1].toDouble();
-        translation->translate.z = translateArray[2].toDouble();
-
-        node->transformations.push_back(translation);
-    }
-
-    // parse rotation if defined
-    if (object.contains("rotate")) {
-        if (!object["rotate"].isArray()) {
-            std::cout << "group rotate must be of type array" << std::endl;
-            return false;
+        // parse primitives if any
+        if (field == "primitives") {
+            if (json.peek() != JsonCursor::Type::ARRAY) {
+                return json.fail("group primitives must be of type array");
+            }
+            return json.readArray([&](size_t) {
+                if (json.peek() != JsonCursor::Type::OBJECT) {
+                    return json.fail("primitive must be of type object");
+                }
+                return parsePrimitive(json);
+            });
         }
 
-        QJsonArray rotateArray = object["rotate"].toArray();
-        if (rotateArray.size() != 4) {
-            std::cout << "group rotate must have 4 elements" << std::endl;
-            return false;
-        }
-        if (!rotateArray[0].isDouble() || !rotateArray[1].isDouble() || !rotateArray[2].isDouble() || !rotateArray[3].isDouble()) {
-            std::cout << "group rotate must contain floating-point values" << std::endl;
-            return false;
+        // children groups: only note where they are
+        if (field == "groups") {
+            fields.groups = json.mark();
+            return json.skipValue();
         }
 
-        SceneTransformation *rotation = new SceneTransformation();
-        rotation->type = TransformationType::TRANSFORMATION_ROTATE;
-        rotation->rotate.x = rotateArray[0].toDouble();
-        rotation->rotate.y = rotateArray[1].toDouble();
-        rotation->rotate.z = rotateArray[2].toDouble();
-        rotation->angle = rotateArray[3].toDouble() * M_PI / 180.f;
+        return unknownField(json, field, objectName);
+    });
+    if (!ok) return false;
 
-        node->transformations.push_back(rotation);
+    uint32_t firstTransformation = (uint32_t)m_graph->transformations.size();
+    for (int i = 0; i < TRANSFORMATION_KINDS; i++) {
+        if (hasTransformation[i]) m_graph->transformations.push_back(transformations[i]);
     }
 
-    // parse scale if defined
-    if (object.contains("scale")) {
-        if (!object["scale"].isArray()) {
-            std::cout << "group scale must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray scaleArray = object["scale"].toArray();
-        if (scaleArray.size() != 3) {
-            std::cout << "group scale must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!scaleArray[0].isDouble() || !scaleArray[1].isDouble() || !scaleArray[2].isDouble()) {
-            std::cout << "group scale must contain floating-point values" << std::endl;
-            return false;
-        }
-
-        SceneTransformation *scale = new SceneTransformation();
-        scale->type = TransformationType::TRANSFORMATION_SCALE;
-        scale->scale.x = scaleArray[0].toDouble();
-        scale->scale.y = scaleArray[1].toDouble();
-        scale->scale.z = scaleArray[2].toDouble();
+    SceneNode &parsed = m_graph->nodes[node];
+    parsed.transformations = {firstTransformation, (uint32_t)m_graph->transformations.size() - firstTransformation};
+    parsed.lights = {firstLight, (uint32_t)m_graph->lights.size() - firstLight};
+    parsed.primitives = {firstPrimitive, (uint32_t)m_graph->primitives.size() - firstPrimitive};
+    return true;
+}
 
-        node->transformations.push_back(scale);
+bool ScenefileReader::parseGroups(JsonCursor &json, uint32_t parent) {
+    if (json.peek() != JsonCursor::Type::ARRAY) {
+        return json.fail("groups must be of type array");
     }
-
-    // parse matrix if defined
-    if (object.contains("matrix")) {
-        if (!object["matrix"].isArray()) {
-            std::cout << "group matrix must be of type array of array" << std::endl;
-            return false;
-        }
-
-        QJsonArray matrixArray = object["matrix"].toArray();
-        if (matrixArray.size() != 4) {
-            std::cout << "group matrix must be 4x4" << std::endl;
-            return false;
-        }
-
-        SceneTransformation *matrixTransformation = new SceneTransformation();
-        matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
-
-        float *matrixPtr = glm::value_ptr(matrixTransformation->matrix);
-        int rowIndex = 0;
-        for (auto row : matrixArray) {
-            if (!row.isArray()) {
-                std::cout << "group matrix must be of type array of array" << std::endl;
-                return false;
-            }
-
-            QJsonArray rowArray = row.toArray();
-            if (rowArray.size() != 4) {
-                std::cout << "group matrix must be 4x4" << std::endl;
-                return false;
-            }
-
-            int colIndex = 0;
-            for (auto val : rowArray) {
-                if (!val.isDouble()) {
-                    std::cout << "group matrix must contain all floating-point values" << std::endl;
-                    return false;
-                }
-
-                // fill in column-wise
-                matrixPtr[colIndex * 4 + rowIndex] = (float)val.toDouble();
-                colIndex++;
-            }
-            rowIndex++;
-        }
-
-        node->transformations.push_back(matrixTransformation);
+    if (parent == 0 && m_parallel) {
+        return parseTopLevelGroups(json);
     }
 
-    // parse lights if any
-    if (object.contains("lights")) {
-        if (!object["lights"].isArray()) {
-            std::cout << "group lights must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray lightsArray = object["lights"].toArray();
-        for (auto light : lightsArray) {
-            if (!light.isObject()) {
-                std::cout << "light must be of type object" << std::endl;
-                return false;
-            }
+    // Two rounds, so that the parent's children sit together in every
+    // array: first the groups themselves, then each one's own groups
+    size_t base = m_pendingGroups.size();
+    bool ok = json.readArray([&](size_t) {
+        return parseGroup(json);
+    });
+    return ok && finishGroups(json, parent, base);
+}
 
-            if (!parseLightData(light.toObject(), node)) {
-                return false;
-            }
-        }
+bool ScenefileReader::parseGroup(JsonCursor &json) {
+    if (json.peek() != JsonCursor::Type::OBJECT) {
+        return json.fail("group items must be of type object");
     }
 
-    // parse primitives if any
-    if (object.contains("primitives")) {
-        if (!object["primitives"].isArray()) {
-            std::cout << "group primitives must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray primitivesArray = object["primitives"].toArray();
-        for (auto primitive : primitivesArray) {
-            if (!primitive.isObject()) {
-                std::cout << "primitive must be of type object" << std::endl;
-                return false;
-            }
-
-            if (!parsePrimitive(primitive.toObject(), node)) {
-                return false;
-            }
-        }
+    uint32_t node = addNode();
+    GroupFields fields;
+    if (!parseGroupData(json, node, "group", fields)) {
+        return false;
     }
 
-    // parse children groups if any
-    if (object.contains("groups")) {
-        if (!parseGroups(object["groups"], node)) {
-            return false;
+    // if its a reference to a template group use that instead; nothing
+    // has been added since this group, so it can simply be dropped
+    if (fields.hasName) {
+        auto found = m_templates.find(fields.name);
+        if (found != m_templates.end()) {
+            removeLastNode();
+            m_pendingGroups.push_back({found->second, NO_OFFSET});
+            return true;
         }
     }
-
+    m_pendingGroups.push_back({node, fields.groups});
     return true;
 }
 
-bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
-    if (!groups.isArray()) {
-        std::cout << "groups must be of type array" << std::endl;
-        return false;
+bool ScenefileReader::finishGroups(JsonCursor &json, uint32_t parent, size_t base) {
+    size_t end = m_pendingGroups.size();
+    m_graph->nodes[parent].children = {(uint32_t)m_graph->children.size(), (uint32_t)(end - base)};
+    for (size_t i = base; i < end; i++) {
+        m_graph->children.push_back(m_pendingGroups[i].first);
     }
 
-    QJsonArray groupsArray = groups.toArray();
-    for (auto group : groupsArray) {
-        if (!group.isObject()) {
-            std::cout << "group items must be of type object" << std::endl;
+    size_t resume = json.mark();
+    for (size_t i = base; i < end; i++) {
+        // By value: the nested calls push onto the list
+        auto [node, groups] = m_pendingGroups[i];
+        if (groups == NO_OFFSET) continue;
+        json.seek(groups);
+        if (!parseGroups(json, node)) {
             return false;
         }
+    }
+    json.seek(resume);
+    m_pendingGroups.resize(base);
 
-        QJsonObject groupData = group.toObject();
-        if (groupData.contains("name")) {
-            if (!groupData["name"].isString()) {
-                std::cout << "group name must be of type string" << std::endl;
-                return false;
-            }
+    return true;
+}
 
-            // if its a reference to a template group append it
-            std::string groupName = groupData["name"].toString().toStdString();
-            if (m_templates.contains(groupName)) {
-                parent->children.push_back(m_templates[groupName]);
-                continue;
+/**
+ * Parse the root's groups. Large files are split into runs of top-level
+ * groups that worker threads parse into graphs of their own, merged after.
+ * The templates are all known by now, so the workers only look them up.
+ */
+bool ScenefileReader::parseTopLevelGroups(JsonCursor &json) {
+    // Only find where each group starts first; skipping is far quicker
+    // than parsing
+    size_t arrayStart = json.mark();
+    std::vector<size_t> offsets;
+    bool ok = json.readArray([&](size_t) {
+        offsets.push_back(json.mark());
+        return json.skipValue();
+    });
+    if (!ok) return false;
+    size_t arrayEnd = json.mark();
+
+    JobSystem &jobs = JobSystem::get();
+    size_t bytes = arrayEnd - arrayStart;
+    if (offsets.size() < 2 || bytes < PARALLEL_MIN_BYTES || jobs.getThreadCount() < 1) {
+        m_parallel = false;
+        json.seek(arrayStart);
+        bool parsed = parseGroups(json, 0);
+        m_parallel = true;
+        return parsed;
+    }
+
+    // Runs of about equal size, a few per thread for balance
+    size_t runCount = std::min(offsets.size(), (size_t)(jobs.getThreadCount() + 1) * 4);
+    size_t runBytes = bytes / runCount + 1;
+    std::vector<size_t> runStarts = {0};
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] - offsets[runStarts.back()] >= runBytes) runStarts.push_back(i);
+    }
+    runStarts.push_back(offsets.size());
+    runCount = runStarts.size() - 1;
+
+    // Template nodes are flagged in the workers' graphs, as the merge
+    // leaves them where they are
+    std::map<std::string, uint32_t, std::less<>> templates;
+    for (const auto &[name, node] : m_templates) {
+        templates.emplace(name, node | TEMPLATE_NODE);
+    }
+
+    std::vector<std::unique_ptr<ScenefileReader>> workers(runCount);
+    std::vector<JsonCursor> cursors(runCount, JsonCursor(m_text.data(), m_text.size()));
+    jobs.parallelFor(runCount, 1, [&](size_t begin, size_t end) {
+        for (size_t run = begin; run < end; run++) {
+            size_t first = runStarts[run], last = runStarts[run + 1];
+            auto worker = std::make_unique<ScenefileReader>(file_name);
+            worker->m_parallel = false;
+            worker->m_text = m_text;
+            worker->m_basePath = m_basePath;
+            worker->m_templates = templates;
+            size_t runEnd = last < offsets.size() ? offsets[last] : arrayEnd;
+            worker->m_graph = std::make_unique<SceneGraph>(runEnd - offsets[first]);
+            worker->addNode(); // stands in for the root
+
+            JsonCursor &cursor = cursors[run];
+            bool parsed = true;
+            for (size_t i = first; i < last && parsed; i++) {
+                cursor.seek(offsets[i]);
+                parsed = worker->parseGroup(cursor);
             }
+            if (parsed) worker->finishGroups(cursor, 0, 0);
+            workers[run] = std::move(worker);
         }
+    });
 
-        SceneNode *node = new SceneNode;
-        m_nodes.push_back(node);
-        parent->children.push_back(node);
-
-        if (!parseGroupData(group.toObject(), node)) {
-            return false;
-        }
+    // The first error in file order is the one reported
+    for (const JsonCursor &cursor : cursors) {
+        if (cursor.hasError()) return json.fail(cursor.getErrorOffset(), cursor.getError());
     }
 
+    mergeGroups(workers);
+    json.seek(arrayEnd);
     return true;
 }
 
+// Append the workers' graphs in order, their top-level groups becoming the
+// root's children
+void ScenefileReader::mergeGroups(std::vector<std::unique_ptr<ScenefileReader>> &workers) {
+    SceneGraph &graph = *m_graph;
+
+    uint32_t topLevel = 0;
+    for (const auto &worker : workers) {
+        topLevel += worker->m_graph->nodes[0].children.count;
+    }
+    size_t rootSlot = graph.children.size();
+    graph.nodes[0].children = {(uint32_t)rootSlot, topLevel};
+    graph.children.resize(rootSlot + topLevel);
+
+    for (const auto &worker : workers) {
+        SceneGraph &part = *worker->m_graph;
+        // The part's node 0 is the root; its children come first in its
+        // child list, since finishGroups adds them before reading further
+        uint32_t nodeOffset = (uint32_t)graph.nodes.size() - 1;
+        uint32_t transformationOffset = (uint32_t)graph.transformations.size();
+        uint32_t lightOffset = (uint32_t)graph.lights.size();
+        uint32_t primitiveOffset = (uint32_t)graph.primitives.size();
+        uint32_t topCount = part.nodes[0].children.count;
+        uint32_t childOffset = (uint32_t)graph.children.size();
+
+        auto mapNode = [&](uint32_t node) {
+            return node & TEMPLATE_NODE ? node & ~TEMPLATE_NODE : node + nodeOffset;
+        };
+        for (uint32_t i = 0; i < topCount; i++) {
+            graph.children[rootSlot++] = mapNode(part.children[i]);
+        }
+        for (size_t i = topCount; i < part.children.size(); i++) {
+            graph.children.push_back(mapNode(part.children[i]));
+        }
+
+        for (size_t i = 1; i < part.nodes.size(); i++) {
+            SceneNode node = part.nodes[i];
+            node.transformations.first += transformationOffset;
+            node.lights.first += lightOffset;
+            node.primitives.first += primitiveOffset;
+            node.children.first = node.children.count ? node.children.first - topCount + childOffset : 0;
+            graph.nodes.push_back(node);
+        }
+        graph.transformations.insert(graph.transformations.end(), part.transformations.begin(),
+                                     part.transformations.end());
+        graph.lights.insert(graph.lights.end(), part.lights.begin(), part.lights.end());
+        graph.primitives.insert(graph.primitives.end(), std::make_move_iterator(part.primitives.begin()),
+                                std::make_move_iterator(part.primitives.end()));
+    }
+}
+
 // /**
 //  * Parse an <object type="primitive"> tag into node.
 //  */
@@ -1029,233 +1006,102 @@ bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
 //     return true;
 // }
 
-bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
-    QStringList requiredFields = {"type"};
-
-    // 🔧 FIX 1: Added "emissive" to this list
-    QStringList optionalFields = {
-                                  "meshFile", "ambient", "diffuse", "specular", "emissive", "reflective", "transparent", "shininess", "ior",
-                                  "blend", "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV"};
-
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : prim.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
-    }
-    for (auto field : requiredFields) {
-        if (!prim.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
-    }
 
-    if (!prim["type"].isString()) {
-        std::cout << "primitive type must be of type string" << std::endl;
-        return false;
-    }
-    std::string primType = prim["type"].toString().toStdString();
+bool ScenefileReader::parsePrimitive(JsonCursor &json) {
+    size_t start = json.mark();
 
     // Default primitive
-    ScenePrimitive *primitive = new ScenePrimitive();
+    ScenePrimitive *primitive = &m_graph->primitives.emplace_back();
     SceneMaterial &mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
     mat.textureMap.isUsed = false;
     mat.bumpMap.isUsed = false;
     mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
-    node->primitives.push_back(primitive);
-
-    std::filesystem::path basepath = std::filesystem::path(file_name).parent_path().parent_path();
-    if (primType == "sphere")
-        primitive->type = PrimitiveType::PRIMITIVE_SPHERE;
-    else if (primType == "cube")
-        primitive->type = PrimitiveType::PRIMITIVE_CUBE;
-    else if (primType == "cylinder")
-        primitive->type = PrimitiveType::PRIMITIVE_CYLINDER;
-    else if (primType == "cone")
-        primitive->type = PrimitiveType::PRIMITIVE_CONE;
-    else if (primType == "mesh") {
-        primitive->type = PrimitiveType::PRIMITIVE_MESH;
-        if (!prim.contains("meshFile")) {
-            std::cout << "primitive type mesh must contain field meshFile" << std::endl;
-            return false;
-        }
-        if (!prim["meshFile"].isString()) {
-            std::cout << "primitive meshFile must be of type string" << std::endl;
-            return false;
-        }
 
-        std::filesystem::path relativePath(prim["meshFile"].toString().toStdString());
-        primitive->meshfile = (basepath / relativePath).string();
-    }
-    else {
-        std::cout << "unknown primitive type \"" << primType << "\"" << std::endl;
-        return false;
-    }
-
-    if (prim.contains("ambient")) {
-        if (!prim["ambient"].isArray()) {
-            std::cout << "primitive ambient must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray ambient = prim["ambient"].toArray();
-        if (ambient.size() != 3) {
-            std::cout << "primitive ambient must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!ambient[0].isDouble() || !ambient[1].isDouble() || !ambient[2].isDouble()) {
-            std::cout << "primitive ambient must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cAmbient.r = ambient[0].toDouble();
-        mat.cAmbient.g = ambient[1].toDouble();
-        mat.cAmbient.b = ambient[2].toDouble();
-    }
-
-    if (prim.contains("diffuse")) {
-        if (!prim["diffuse"].isArray()) {
-            std::cout << "primitive diffuse must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray diffuse = prim["diffuse"].toArray();
-        if (diffuse.size() != 3) {
-            std::cout << "primitive diffuse must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!diffuse[0].isDouble() || !diffuse[1].isDouble() || !diffuse[2].isDouble()) {
-            std::cout << "primitive diffuse must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cDiffuse.r = diffuse[0].toDouble();
-        mat.cDiffuse.g = diffuse[1].toDouble();
-        mat.cDiffuse.b = diffuse[2].toDouble();
-    }
-
-    if (prim.contains("specular")) {
-        if (!prim["specular"].isArray()) {
-            std::cout << "primitive specular must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray specular = prim["specular"].toArray();
-        if (specular.size() != 3) {
-            std::cout << "primitive specular must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!specular[0].isDouble() || !specular[1].isDouble() || !specular[2].isDouble()) {
-            std::cout << "primitive specular must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cSpecular.r = specular[0].toDouble();
-        mat.cSpecular.g = specular[1].toDouble();
-        mat.cSpecular.b = specular[2].toDouble();
-    }
-
-    // 🔧 FIX 2: Added logic to parse "emissive"
-    if (prim.contains("emissive")) {
-        if (!prim["emissive"].isArray()) {
-            std::cout << "primitive emissive must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray emissive = prim["emissive"].toArray();
-        if (emissive.size() != 3) {
-            std::cout << "primitive emissive must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!emissive[0].isDouble() || !emissive[1].isDouble() || !emissive[2].isDouble()) {
-            std::cout << "primitive emissive must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cEmissive.r = emissive[0].toDouble();
-        mat.cEmissive.g = emissive[1].toDouble();
-        mat.cEmissive.b = emissive[2].toDouble();
-    }
-
-    if (prim.contains("reflective")) {
-        if (!prim["reflective"].isArray()) {
-            std::cout << "primitive reflective must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray reflective = prim["reflective"].toArray();
-        if (reflective.size() != 3) {
-            std::cout << "primitive reflective must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!reflective[0].isDouble() || !reflective[1].isDouble() || !reflective[2].isDouble()) {
-            std::cout << "primitive reflective must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cReflective.r = reflective[0].toDouble();
-        mat.cReflective.g = reflective[1].toDouble();
-        mat.cReflective.b = reflective[2].toDouble();
-    }
-
-    if (prim.contains("transparent")) {
-        if (!prim["transparent"].isArray()) {
-            std::cout << "primitive transparent must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray transparent = prim["transparent"].toArray();
-        if (transparent.size() != 3) {
-            std::cout << "primitive transparent must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!transparent[0].isDouble() || !transparent[1].isDouble() || !transparent[2].isDouble()) {
-            std::cout << "primitive transparent must contain floating-point values" << std::endl;
-            return false;
-        }
-        mat.cTransparent.r = transparent[0].toDouble();
-        mat.cTransparent.g = transparent[1].toDouble();
-        mat.cTransparent.b = transparent[2].toDouble();
-    }
-
-    if (prim.contains("shininess")) {
-        if (!prim["shininess"].isDouble()) {
-            std::cout << "primitive shininess must be of type float" << std::endl;
-            return false;
-        }
-        mat.shininess = (float)prim["shininess"].toDouble();
-    }
-
-    if (prim.contains("ior")) {
-        if (!prim["ior"].isDouble()) {
-            std::cout << "primitive ior must be of type float" << std::endl;
-            return false;
-        }
-        mat.ior = (float)prim["ior"].toDouble();
-    }
-
-    if (prim.contains("blend")) {
-        if (!prim["blend"].isDouble()) {
-            std::cout << "primitive blend must be of type float" << std::endl;
-            return false;
-        }
-        mat.blend = (float)prim["blend"].toDouble();
-    }
-
-    if (prim.contains("textureFile")) {
-        if (!prim["textureFile"].isString()) {
-            std::cout << "primitive textureFile must be of type string" << std::endl;
-            return false;
-        }
-        std::filesystem::path fileRelativePath(prim["textureFile"].toString().toStdString());
-        mat.textureMap.filename = (basepath / fileRelativePath).string();
-        mat.textureMap.repeatU = prim.contains("textureU") && prim["textureU"].isDouble() ? prim["textureU"].toDouble() : 1;
-        mat.textureMap.repeatV = prim.contains("textureV") && prim["textureV"].isDouble() ? prim["textureV"].toDouble() : 1;
-        mat.textureMap.isUsed = true;
-    }
-
-    if (prim.contains("bumpMapFile")) {
-        if (!prim["bumpMapFile"].isString()) {
-            std::cout << "primitive bumpMapFile must be of type string" << std::endl;
-            return false;
-        }
-        std::filesystem::path fileRelativePath(prim["bumpMapFile"].toString().toStdString());
-        mat.bumpMap.filename = (basepath / fileRelativePath).string();
-        mat.bumpMap.repeatU = prim.contains("bumpMapU") && prim["bumpMapU"].isDouble() ? prim["bumpMapU"].toDouble() : 1;
-        mat.bumpMap.repeatV = prim.contains("bumpMapV") && prim["bumpMapV"].isDouble() ? prim["bumpMapV"].toDouble() : 1;
-        mat.bumpMap.isUsed = true;
+    auto resolvePath = [this](std::string_view relativePath) {
+        return (std::filesystem::path(m_basePath) / std::filesystem::path(relativePath)).string();
+    };
+
+    bool hasType = false;
+    std::string meshfile;
+    float textureU = 1, textureV = 1, bumpMapU = 1, bumpMapV = 1;
+    bool ok = json.readObject([&](std::string_view field) {
+        if (field == "type") {
+            hasType = true;
+            size_t at = json.mark();
+            std::string_view primType;
+            if (!readString(json, primType, "primitive type")) return false;
+            if (primType == "sphere")
+                primitive->type = PrimitiveType::PRIMITIVE_SPHERE;
+            else if (primType == "cube")
+                primitive->type = PrimitiveType::PRIMITIVE_CUBE;
+            else if (primType == "cylinder")
+                primitive->type = PrimitiveType::PRIMITIVE_CYLINDER;
+            else if (primType == "cone")
+                primitive->type = PrimitiveType::PRIMITIVE_CONE;
+            else if (primType == "mesh")
+                primitive->type = PrimitiveType::PRIMITIVE_MESH;
+            else
+                return json.fail(at, "unknown primitive type \"" + std::string(primType) + "\"");
+            return true;
+        }
+        if (field == "meshFile") {
+            std::string_view relativePath;
+            if (!readString(json, relativePath, "primitive meshFile")) return false;
+            meshfile = resolvePath(relativePath);
+            return true;
+        }
+
+        if (field == "ambient") return readFloats(json, &mat.cAmbient.r, 3, "primitive ambient");
+        if (field == "diffuse") return readFloats(json, &mat.cDiffuse.r, 3, "primitive diffuse");
+        if (field == "specular") return readFloats(json, &mat.cSpecular.r, 3, "primitive specular");
+        if (field == "emissive") return readFloats(json, &mat.cEmissive.r, 3, "primitive emissive");
+        if (field == "reflective") return readFloats(json, &mat.cReflective.r, 3, "primitive reflective");
+        if (field == "transparent") return readFloats(json, &mat.cTransparent.r, 3, "primitive transparent");
+
+        if (field == "shininess") return readFloat(json, mat.shininess, "primitive shininess");
+        if (field == "ior") return readFloat(json, mat.ior, "primitive ior");
+        if (field == "blend") return readFloat(json, mat.blend, "primitive blend");
+
+        if (field == "textureFile") {
+            std::string_view relativePath;
+            if (!readString(json, relativePath, "primitive textureFile")) return false;
+            mat.textureMap.filename = resolvePath(relativePath);
+            mat.textureMap.isUsed = true;
+            return true;
+        }
+        if (field == "textureU") return readOptionalFloat(json, textureU);
+        if (field == "textureV") return readOptionalFloat(json, textureV);
+
+        if (field == "bumpMapFile") {
+            std::string_view relativePath;
+            if (!readString(json, relativePath, "primitive bumpMapFile")) return false;
+            mat.bumpMap.filename = resolvePath(relativePath);
+            mat.bumpMap.isUsed = true;
+            return true;
+        }
+        if (field == "bumpMapU") return readOptionalFloat(json, bumpMapU);
+        if (field == "bumpMapV") return readOptionalFloat(json, bumpMapV);
+
+        return unknownField(json, field, "primitive");
+    });
+    if (!ok) return false;
+
+    if (!hasType) return missingField(json, start, "type", "primitive");
+    if (primitive->type == PrimitiveType::PRIMITIVE_MESH) {
+        if (meshfile.empty()) {
+            return json.fail(start, "primitive type mesh must contain field meshFile");
+        }
+        primitive->meshfile = std::move(meshfile);
+    }
+    if (mat.textureMap.isUsed) {
+        mat.textureMap.repeatU = textureU;
+        mat.textureMap.repeatV = textureV;
+    }
+    if (mat.bumpMap.isUsed) {
+        mat.bumpMap.repeatU = bumpMapU;
+        mat.bumpMap.repeatV = bumpMapV;
     }
 
     return true;
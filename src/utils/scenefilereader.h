@@ -1,14 +1,16 @@
 #pragma once
 
 #include "scenedata.h"
+#include "jsoncursor.h"
 
 #include <vector>
 #include <map>
-
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <memory>
+#include <string_view>
 
 // This class parses the scene graph specified by the CS123 Xml file format.
+// The file is memory-mapped and read in one pass with a JsonCursor, straight
+// into the SceneGraph; no JSON document is built.
 class ScenefileReader {
 public:
     // Create a ScenefileReader, passing it the scene file.
@@ -20,31 +22,58 @@ public:
     // Parse the XML scene file. Returns false if scene is invalid.
     bool readJSON();
 
+    // Parse big files' top-level groups on the job system's threads (on by
+    // default)
+    void setParallel(bool parallel) { m_parallel = parallel; }
+
     SceneGlobalData getGlobalData() const;
 
     SceneCameraData getCameraData() const;
 
-    SceneNode *getRootNode() const;
+    // Valid once readJSON() has succeeded
+    const SceneGraph &getSceneGraph() const;
 
 private:
+    struct GroupFields;
+
     // The filename should be contained within this parser implementation.
     // If you want to parse a new file, instantiate a different parser.
-    bool parseGlobalData(const QJsonObject &globaldata);
-    bool parseCameraData(const QJsonObject &cameradata);
-    bool parseTemplateGroups(const QJsonValue &templateGroups);
-    bool parseTemplateGroupData(const QJsonObject &templateGroup);
-    bool parseGroups(const QJsonValue &groups, SceneNode *parent);
-    bool parseGroupData(const QJsonObject &object, SceneNode *node);
-    bool parsePrimitive(const QJsonObject &prim, SceneNode *node);
-    bool parseLightData(const QJsonObject &lightData, SceneNode *node);
+    // Each of these reads the value at the cursor.
+    bool parseScenefile(JsonCursor &json);
+    bool parseGlobalData(JsonCursor &json);
+    bool parseCameraData(JsonCursor &json);
+    bool parseTemplateGroups(JsonCursor &json);
+    bool parseTemplateGroupData(JsonCursor &json);
+    // Nodes are passed by index: adding nodes moves them
+    bool parseGroups(JsonCursor &json, uint32_t parent);
+    // Reads one group into a new node, queued on m_pendingGroups
+    bool parseGroup(JsonCursor &json);
+    // Gives parent the groups queued from base on, then reads theirs
+    bool finishGroups(JsonCursor &json, uint32_t parent, size_t base);
+    bool parseTopLevelGroups(JsonCursor &json);
+    void mergeGroups(std::vector<std::unique_ptr<ScenefileReader>> &workers);
+    bool parseGroupData(JsonCursor &json, uint32_t node, const char *objectName, GroupFields &fields);
+    bool parsePrimitive(JsonCursor &json);
+    bool parseLightData(JsonCursor &json);
+    uint32_t addNode();
+    void removeLastNode();
 
     std::string file_name;
+    std::string_view m_text; // the whole file, while readJSON runs
+    std::string m_basePath; // mesh and texture paths are relative to this
 
-    mutable std::map<std::string, SceneNode *> m_templates;
+    mutable std::map<std::string, uint32_t, std::less<>> m_templates;
 
     SceneGlobalData m_globalData;
     SceneCameraData m_cameraData;
 
-    SceneNode *m_root;
-    std::vector<SceneNode *> m_nodes;
+    std::unique_ptr<SceneGraph> m_graph;
+
+    // Groups whose children are still to be read, as (node, offset of its
+    // "groups" array); used as a stack by nested parseGroups calls
+    std::vector<std::pair<uint32_t, size_t>> m_pendingGroups;
+
+    // Smaller root group arrays aren't worth splitting up
+    static constexpr size_t PARALLEL_MIN_BYTES = 1 << 20;
+    bool m_parallel = true;
 };
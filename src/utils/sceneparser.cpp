@@ -1,9 +1,15 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "jobsystem.h"
+#include "frustum.h"
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <span>
+#include <unordered_map>
 
 
 
@@ -58,35 +64,299 @@ static SceneLightData makeLight(const SceneLight* L, const glm::mat4 &CTM) {
 }
 
 
-static void traverse(const SceneNode* node,
-                     const glm::mat4 &parentCTM,
-                     RenderData &out)
-{
-    // accumulate CTM
-    glm::mat4 M = parentCTM;
-    for (const SceneTransformation* t : node->transformations) {
-        M = M * toMat(t);
+// A light flattened in some local space, moved by M
+static SceneLightData moveLight(const SceneLightData &local, const glm::mat4 &M) {
+    SceneLightData out = local;
+    if (local.type == LightType::LIGHT_POINT || local.type == LightType::LIGHT_SPOT) {
+        out.pos = M * local.pos;
     }
+    if (local.type == LightType::LIGHT_DIRECTIONAL || local.type == LightType::LIGHT_SPOT) {
+        out.dir = glm::vec4(glm::normalize(glm::vec3(M * local.dir)), 0.f);
+    }
+    return out;
+}
+
+// Bytes that tell materials apart, for interning them
+static std::string materialKey(const SceneMaterial &m) {
+    std::string key;
+    auto add = [&key](const auto &value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto addMap = [&](const SceneFileMap &map) {
+        add(map.isUsed);
+        if (!map.isUsed) return;
+        add(map.repeatU);
+        add(map.repeatV);
+        add(map.filename.size());
+        key += map.filename;
+    };
+    add(m.cAmbient);
+    add(m.cDiffuse);
+    add(m.cSpecular);
+    add(m.shininess);
+    add(m.cReflective);
+    add(m.cTransparent);
+    add(m.ior);
+    add(m.blend);
+    add(m.cEmissive);
+    addMap(m.textureMap);
+    addMap(m.bumpMap);
+    return key;
+}
+
+void RenderShapes::resize(size_t count) {
+    types.resize(count);
+    ctms.resize(count);
+    materials.resize(count);
+    boundsMin.resize(count);
+    boundsMax.resize(count);
+    meshes.resize(count);
+}
+
+void RenderShapes::clear() {
+    resize(0);
+    materialTable.clear();
+    meshTable.clear();
+}
+
+namespace {
+
+// Flattens the graph into preallocated shape and light lists. Subtree sizes
+// are counted first, so every node knows where its shapes and lights go and
+// big subtrees can be written by several threads at once. Nodes used in
+// several places (template groups) are flattened once in their own space;
+// every use then only copies that list with its CTM applied.
+//
+// Shapes are flattened as (graph primitive, CTM) pairs; their materials and
+// mesh paths are interned per graph primitive beforehand and filled in last.
+class Flattener {
+public:
+    // Subtrees with fewer shapes and lights are written on one thread
+    static constexpr size_t PARALLEL_MIN_ITEMS = 4096;
 
-    // primitives
-    for (const ScenePrimitive* p : node->primitives) {
-        RenderShapeData rs{};
-        rs.primitive = *p;   // copy primitive data
-        rs.ctm       = M;    // cumulative transform
-        out.shapes.push_back(rs);
+    Flattener(const SceneGraph &graph, RenderData &out)
+        : m_graph(graph),
+          m_out(out)
+    {
     }
 
-    // lights
-    for (const SceneLight* L : node->lights) {
-        out.lights.push_back(makeLight(L, M));
+    void run() {
+        size_t nodeCount = m_graph.nodes.size();
+        m_shapeCounts.assign(nodeCount, UNCOUNTED);
+        m_lightCounts.assign(nodeCount, 0);
+        m_uses.assign(nodeCount, 0);
+        for (uint32_t child : m_graph.children) {
+            m_uses[child]++;
+        }
+        count(0);
+        internPrimitives();
+
+        // Shared subtrees first, in their own space. Each one is built
+        // before anything that uses it.
+        m_instances.resize(nodeCount);
+        m_built.assign(nodeCount, false);
+        buildInstances(0);
+
+        RenderShapes &shapes = m_out.shapes;
+        std::vector<uint32_t> primitives(m_shapeCounts[0]);
+        shapes.resize(m_shapeCounts[0]);
+        m_out.lights.resize(m_lightCounts[0]);
+        write(0, glm::mat4(1.f), {primitives.data(), shapes.ctms.data(), m_out.lights.data()}, false);
+
+        auto fillShapes = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const InternedPrimitive &p = m_primitives[primitives[i]];
+                shapes.types[i] = p.type;
+                shapes.materials[i] = p.material;
+                shapes.meshes[i] = p.mesh;
+                transformUnitBounds(shapes.ctms[i], shapes.boundsMin[i], shapes.boundsMax[i]);
+            }
+        };
+        if (shapes.size() < PARALLEL_MIN_ITEMS) {
+            fillShapes(0, shapes.size());
+        }
+        else {
+            JobSystem::get().parallelFor(shapes.size(), PARALLEL_MIN_ITEMS / 4, fillShapes);
+        }
     }
 
-    // recurse on children
-    for (const SceneNode* child : node->children) {
-        traverse(child, M, out);
+private:
+    static constexpr size_t UNCOUNTED = SIZE_MAX;
+
+    struct InternedPrimitive {
+        PrimitiveType type;
+        uint32_t material;
+        uint32_t mesh;
+    };
+
+    // Where a subtree's shapes (graph primitive and CTM) and lights go
+    struct Output {
+        uint32_t *primitives;
+        glm::mat4 *ctms;
+        SceneLightData *lights;
+    };
+
+    struct Instance {
+        std::vector<uint32_t> primitives;
+        std::vector<glm::mat4> ctms;
+        std::vector<SceneLightData> lights;
+    };
+
+    bool isShared(uint32_t node) const { return m_uses[node] > 1; }
+
+    // Shapes and lights in the subtree of node, counting every use of a
+    // shared subtree
+    void count(uint32_t node) {
+        if (m_shapeCounts[node] != UNCOUNTED) return;
+        const SceneNode &n = m_graph.nodes[node];
+        size_t shapes = n.primitives.count;
+        size_t lights = n.lights.count;
+        for (uint32_t child : m_graph.getChildren(n)) {
+            count(child);
+            shapes += m_shapeCounts[child];
+            lights += m_lightCounts[child];
+        }
+        m_shapeCounts[node] = shapes;
+        m_lightCounts[node] = lights;
     }
-}
 
+    // Only nodes reached from the root are counted, so template groups no
+    // shape uses don't add to the tables
+    void internPrimitives() {
+        m_primitives.resize(m_graph.primitives.size());
+        for (uint32_t node = 0; node < m_graph.nodes.size(); node++) {
+            if (m_shapeCounts[node] == UNCOUNTED) continue;
+            const SceneRange &primitives = m_graph.nodes[node].primitives;
+            for (uint32_t p = primitives.first; p < primitives.first + primitives.count; p++) {
+                internPrimitive(p);
+            }
+        }
+    }
+
+    void internPrimitive(uint32_t index) {
+        RenderShapes &shapes = m_out.shapes;
+        const ScenePrimitive &p = m_graph.primitives[index];
+        InternedPrimitive &interned = m_primitives[index];
+        interned.type = p.type;
+
+        auto [material, newMaterial] = m_materialIds.try_emplace(materialKey(p.material),
+                                                                 (uint32_t)shapes.materialTable.size());
+        if (newMaterial) shapes.materialTable.push_back(p.material);
+        interned.material = material->second;
+
+        interned.mesh = RenderShapes::NO_MESH;
+        if (p.type == PrimitiveType::PRIMITIVE_MESH) {
+            auto [mesh, newMesh] = m_meshIds.try_emplace(p.meshfile, (uint32_t)shapes.meshTable.size());
+            if (newMesh) shapes.meshTable.push_back(p.meshfile);
+            interned.mesh = mesh->second;
+        }
+    }
+
+    void buildInstances(uint32_t node) {
+        if (m_built[node]) return;
+        m_built[node] = true;
+        for (uint32_t child : m_graph.getChildren(m_graph.nodes[node])) {
+            buildInstances(child);
+        }
+        if (isShared(node)) {
+            Instance &instance = m_instances[node];
+            instance.primitives.resize(m_shapeCounts[node]);
+            instance.ctms.resize(m_shapeCounts[node]);
+            instance.lights.resize(m_lightCounts[node]);
+            write(node, glm::mat4(1.f),
+                  {instance.primitives.data(), instance.ctms.data(), instance.lights.data()}, true);
+        }
+    }
+
+    // Writes the subtree of node, under parentCTM, to out.
+    // local: node is the one being built as an instance, so it's walked
+    // rather than copied.
+    void write(uint32_t node, const glm::mat4 &parentCTM, Output out, bool local) {
+        if (!local && isShared(node)) {
+            copyInstance(m_instances[node], parentCTM, out);
+            return;
+        }
+
+        const SceneNode &n = m_graph.nodes[node];
+
+        // accumulate CTM
+        glm::mat4 M = parentCTM;
+        for (const SceneTransformation &t : m_graph.getTransformations(n)) {
+            M = M * toMat(&t);
+        }
+
+        // primitives, by their index in the graph
+        for (uint32_t p = 0; p < n.primitives.count; p++) {
+            *out.primitives++ = n.primitives.first + p;
+            *out.ctms++ = M;    // cumulative transform
+        }
+
+        // lights
+        for (const SceneLight &L : m_graph.getLights(n)) {
+            *out.lights++ = makeLight(&L, M);
+        }
+
+        // children, each at its place in the lists: several threads can
+        // take them if there's enough work
+        std::span<const uint32_t> children = m_graph.getChildren(n);
+        size_t items = m_shapeCounts[node] + m_lightCounts[node];
+        if (children.size() < 2 || items < PARALLEL_MIN_ITEMS) {
+            for (uint32_t child : children) {
+                write(child, M, out, false);
+                out.primitives += m_shapeCounts[child];
+                out.ctms += m_shapeCounts[child];
+                out.lights += m_lightCounts[child];
+            }
+            return;
+        }
+
+        std::vector<Output> starts(children.size());
+        for (size_t i = 0; i < children.size(); i++) {
+            starts[i] = out;
+            out.primitives += m_shapeCounts[children[i]];
+            out.ctms += m_shapeCounts[children[i]];
+            out.lights += m_lightCounts[children[i]];
+        }
+        JobSystem::get().parallelFor(children.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                write(children[i], M, starts[i], false);
+            }
+        });
+    }
+
+    void copyInstance(const Instance &instance, const glm::mat4 &M, Output out) {
+        auto copyShapes = [&](size_t begin, size_t end) {
+            std::copy(instance.primitives.begin() + begin, instance.primitives.begin() + end,
+                      out.primitives + begin);
+            for (size_t i = begin; i < end; i++) {
+                out.ctms[i] = M * instance.ctms[i];
+            }
+        };
+        if (instance.ctms.size() < PARALLEL_MIN_ITEMS) {
+            copyShapes(0, instance.ctms.size());
+        }
+        else {
+            JobSystem::get().parallelFor(instance.ctms.size(), PARALLEL_MIN_ITEMS / 4, copyShapes);
+        }
+        for (size_t i = 0; i < instance.lights.size(); i++) {
+            out.lights[i] = moveLight(instance.lights[i], M);
+        }
+    }
+
+    const SceneGraph &m_graph;
+    RenderData &m_out;
+
+    std::vector<size_t> m_shapeCounts;
+    std::vector<size_t> m_lightCounts;
+    std::vector<uint32_t> m_uses; // parents of each node
+    std::vector<InternedPrimitive> m_primitives; // per graph primitive, if reached
+    std::unordered_map<std::string, uint32_t> m_materialIds; // by materialKey()
+    std::unordered_map<std::string, uint32_t> m_meshIds;
+    std::vector<Instance> m_instances;
+    std::vector<bool> m_built;
+};
+
+}
 
 
 bool SceneParser::parse(std::string filepath, RenderData &renderData) {
@@ -104,17 +374,16 @@ bool SceneParser::parse(std::string filepath, RenderData &renderData) {
     renderData.shapes.clear();
     renderData.lights.clear();
 
-    // 3) traverse scene graph starting at root
-    const SceneNode* root = fileReader.getRootNode();
-    if (root != nullptr) {
-        traverse(root, glm::mat4(1.f), renderData);
-    }
+    // 3) flatten the scene graph starting at root
+    Flattener flattener(fileReader.getSceneGraph(), renderData);
+    flattener.run();
 
     // for debug:
     std::cout << "[SceneParser] Parsed scene \""
               << filepath << "\"\n"
               << "  shapes = " << renderData.shapes.size() << "\n"
-              << "  lights = " << renderData.lights.size() << std::endl;
+              << "  lights = " << renderData.lights.size() << "\n"
+              << "  materials = " << renderData.shapes.materialTable.size() << std::endl;
 
     return true;
 }
@@ -1,13 +1,36 @@
 #pragma once
 
 #include "scenedata.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
-// Struct which contains data for a single primitive, to be used for rendering
-struct RenderShapeData {
-    ScenePrimitive primitive;
-    glm::mat4 ctm; // the cumulative transformation matrix
+// The shapes of a scene, one entry per shape at the same index in each
+// array. The draw and cull loops only stream through the first few; the
+// rest is only read while a scene is being set up. Every distinct material
+// and mesh path is stored once, and shapes refer to them by index.
+struct RenderShapes {
+    static constexpr uint32_t NO_MESH = UINT32_MAX;
+
+    // Read every frame
+    std::vector<PrimitiveType> types;
+    std::vector<glm::mat4> ctms;      // the cumulative transformation matrices
+    std::vector<uint32_t> materials;  // into materialTable
+    std::vector<glm::vec3> boundsMin; // world-space bounds of the unit primitive
+    std::vector<glm::vec3> boundsMax;
+
+    // Only read at load
+    std::vector<uint32_t> meshes; // into meshTable, NO_MESH unless a mesh
+
+    std::vector<SceneMaterial> materialTable;
+    std::vector<std::string> meshTable;
+
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+    void resize(size_t count);
+    void clear();
+
+    const SceneMaterial &getMaterial(size_t shape) const { return materialTable[materials[shape]]; }
 };
 
 // Struct which contains all the data needed to render a scene
@@ -16,7 +39,7 @@ struct RenderData {
     SceneCameraData cameraData;
 
     std::vector<SceneLightData> lights;
-    std::vector<RenderShapeData> shapes;
+    RenderShapes shapes;
 };
 
 class SceneParser {
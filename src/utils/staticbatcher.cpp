@@ -0,0 +1,137 @@
+#include "staticbatcher.h"
+#include "primitivemesh.h"
+#include "frustum.h"
+#include "jobsystem.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+// CPU-side batch while the scene is being merged
+struct BatchBuild {
+    std::vector<size_t> shapes; // indices into RenderData::shapes' arrays
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    uint16_t materialId;
+    unsigned int stencilClass;
+    glm::vec3 boundsMin{ INFINITY};
+    glm::vec3 boundsMax{-INFINITY};
+};
+
+// (material ID, cell x, cell y, cell z)
+using BatchKey = std::tuple<int, int, int, int>;
+
+// A unit primitive, indexed once and reused for every shape of its type
+struct UnitMesh {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+}
+
+bool StaticBatch::isVisible(const glm::mat4 &viewProj) const {
+    return isBoxInFrustum(viewProj, boundsMin, boundsMax);
+}
+
+void StaticBatcher::build(const RenderData &renderData, const MaterialTable &materials, int param1, int param2,
+                          GeometryArena &arena, GLState &glState) {
+    destroy(arena);
+
+    std::unordered_map<PrimitiveType, UnitMesh> unitData;
+    std::map<BatchKey, BatchBuild> builds;
+
+    // Group the shapes into batches first; tessellation and baking below
+    // are independent per primitive type and per batch
+    const RenderShapes &shapes = renderData.shapes;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        PrimitiveType type = shapes.types[s];
+        if (type == PrimitiveType::PRIMITIVE_MESH) continue;
+        unitData.try_emplace(type);
+
+        uint16_t materialId = materials.getShapeMaterial(s);
+
+        const glm::vec3 &shapeMin = shapes.boundsMin[s];
+        const glm::vec3 &shapeMax = shapes.boundsMax[s];
+        glm::ivec3 cell = glm::ivec3(glm::floor((shapeMin + shapeMax) * 0.5f / CELL_SIZE));
+
+        BatchBuild &b = builds[BatchKey(materialId, cell.x, cell.y, cell.z)];
+        if (b.shapes.empty()) {
+            b.materialId = materialId;
+            b.stencilClass = materials.getStencilClass(materialId);
+        }
+        b.boundsMin = glm::min(b.boundsMin, shapeMin);
+        b.boundsMax = glm::max(b.boundsMax, shapeMax);
+        b.shapes.push_back(s);
+        m_shapeCount++;
+    }
+
+    JobSystem &jobs = JobSystem::get();
+
+    // A unit primitive per type in use
+    std::vector<std::pair<const PrimitiveType, UnitMesh>*> units;
+    for (auto &unit : unitData) {
+        units.push_back(&unit);
+    }
+    jobs.parallelFor(units.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            UnitMesh &unit = units[i]->second;
+            buildIndexedMesh(generatePrimitiveData(units[i]->first, param1, param2), unit.vertices, unit.indices);
+        }
+    });
+
+    // Bake the transforms, one job per batch
+    std::vector<BatchBuild*> batchBuilds;
+    for (auto &[key, b] : builds) {
+        batchBuilds.push_back(&b);
+    }
+    jobs.parallelFor(batchBuilds.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            BatchBuild &b = *batchBuilds[i];
+            for (size_t s : b.shapes) {
+                const glm::mat4 &ctm = shapes.ctms[s];
+                const UnitMesh &unit = unitData.at(shapes.types[s]);
+                const std::vector<float> &src = unit.vertices;
+
+                // Positions by the CTM, normals by its inverse transpose
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(ctm)));
+                uint32_t base = b.vertices.size() / 6;
+                b.vertices.reserve(b.vertices.size() + src.size());
+                for (size_t v = 0; v + 5 < src.size(); v += 6) {
+                    glm::vec3 p = glm::vec3(ctm * glm::vec4(src[v], src[v + 1], src[v + 2], 1.f));
+                    glm::vec3 n = glm::normalize(normalMatrix * glm::vec3(src[v + 3], src[v + 4], src[v + 5]));
+                    b.vertices.insert(b.vertices.end(), {p.x, p.y, p.z, n.x, n.y, n.z});
+                }
+                for (uint32_t index : unit.indices) {
+                    b.indices.push_back(base + index);
+                }
+            }
+        }
+    });
+
+    m_batches.reserve(builds.size());
+    for (auto &[key, b] : builds) {
+        StaticBatch batch;
+        batch.geometry = arena.allocate(b.vertices, b.indices, glState);
+        batch.materialId = b.materialId;
+        batch.stencilClass = b.stencilClass;
+        batch.boundsMin = b.boundsMin;
+        batch.boundsMax = b.boundsMax;
+        m_batches.push_back(batch);
+    }
+
+    std::cout << "[StaticBatcher] " << m_shapeCount << " shapes, "
+              << materials.size() << " materials -> "
+              << m_batches.size() << " batches" << std::endl;
+}
+
+void StaticBatcher::destroy(GeometryArena &arena) {
+    for (StaticBatch &batch : m_batches) {
+        arena.free(batch.geometry);
+    }
+    m_batches.clear();
+    m_shapeCount = 0;
+}
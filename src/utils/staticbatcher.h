@@ -0,0 +1,53 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "sceneparser.h"
+#include "glstate.h"
+#include "geometryarena.h"
+#include "materialtable.h"
+
+// One merged, pre-transformed mesh: every shape that shares a material and
+// a spatial cell. Drawn with an identity model matrix.
+struct StaticBatch {
+    GeometryHandle geometry = INVALID_GEOMETRY;
+
+    uint16_t materialId;       // see MaterialTable
+    unsigned int stencilClass; // see stencilclass.h
+
+    // World-space bounds of everything in the batch
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // Conservative test against the clip-space frustum of viewProj
+    bool isVisible(const glm::mat4 &viewProj) const;
+};
+
+// Bakes the (static) shapes of a scene into a handful of large meshes in the
+// geometry arena at load time, so a scene with thousands of small objects
+// costs one draw per cell.
+class StaticBatcher {
+public:
+    // Size of a spatial cell in world units
+    static constexpr float CELL_SIZE = 16.f;
+
+    // Rebuild all batches from the shapes in renderData, tessellating the
+    // unit primitives with the given shape parameters. Shapes are grouped by
+    // their ID in the (already built) material table.
+    void build(const RenderData &renderData, const MaterialTable &materials, int param1, int param2,
+               GeometryArena &arena, GLState &glState);
+    void destroy(GeometryArena &arena);
+
+    const std::vector<StaticBatch> &getBatches() const { return m_batches; }
+    int getShapeCount() const { return m_shapeCount; }
+
+private:
+    std::vector<StaticBatch> m_batches;
+    int m_shapeCount = 0;
+};
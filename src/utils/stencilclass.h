@@ -0,0 +1,20 @@
+#pragma once
+
+#include "scenedata.h"
+
+// Stencil layout shared by the G-buffer and lighting passes. The G-buffer
+// pass writes a pixel class into the top bits; pixels it never touches
+// keep the cleared value and count as empty (sky). The low bits are the
+// light-volume counter and are always back to zero between lights.
+constexpr unsigned int STENCIL_LIT           = 0x80; // needs lighting
+constexpr unsigned int STENCIL_EMISSIVE_ONLY = 0x40; // lighting adds nothing
+constexpr unsigned int STENCIL_CLASS_MASK    = 0xC0;
+constexpr unsigned int STENCIL_VOLUME_MASK   = 0x3F;
+
+// Materials with no diffuse and no specular response only show their
+// emissive colour, so the lighting shader can be skipped for them
+inline unsigned int stencilClass(const SceneMaterial &material) {
+    bool diffuse = material.cDiffuse.r > 0.f || material.cDiffuse.g > 0.f || material.cDiffuse.b > 0.f;
+    bool specular = material.cSpecular.r > 0.f || material.cSpecular.g > 0.f || material.cSpecular.b > 0.f;
+    return (diffuse || specular) ? STENCIL_LIT : STENCIL_EMISSIVE_ONLY;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// CPU mirrors of the std140 uniform blocks shared by the shaders. Every
+// member is a vec4/mat4 so the C++ layout matches std140 without padding.
+
+// Uniform buffer binding points
+constexpr unsigned int FRAME_BLOCK_BINDING = 0;
+constexpr unsigned int LIGHT_BLOCK_BINDING = 1;
+constexpr unsigned int VOLUME_LIGHT_BLOCK_BINDING = 2;
+
+constexpr int MAX_LIGHTS = 8;
+
+// `FrameData` block: per-frame camera state
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 proj;         // jittered when temporal upsampling is on
+    glm::vec4 camPos;
+    glm::mat4 viewProj;     // unjittered, for motion vectors
+    glm::mat4 prevViewProj; // unjittered, previous frame
+};
+
+// Entries of the `LightData` block, one array per light type. Everything
+// that doesn't vary per pixel (normalized directions, cone cosines) is
+// computed once on the CPU; see LightList.
+struct DirectionalLightData {
+    glm::vec4 toLight; // normalized
+    glm::vec4 color;
+};
+
+struct PointLightData {
+    glm::vec4 posRadius; // xyz position, w influence radius (0 = unbounded)
+    glm::vec4 color;
+    glm::vec4 atten;
+};
+
+struct SpotLightData {
+    glm::vec4 posRadius;   // xyz position, w influence radius (0 = unbounded)
+    glm::vec4 color;
+    glm::vec4 atten;
+    glm::vec4 dirCosOuter; // xyz normalized direction, w cos(outer angle)
+    glm::vec4 cone;        // x 1 / (cos inner - cos outer), y outer angle (CPU only)
+};
+
+// `LightData` block: global coefficients and the per-type light arrays
+struct LightUniforms {
+    glm::vec4 coeffs;      // ka, kd, ks, unused
+    glm::ivec4 lightCount; // directional, point, spot
+    DirectionalLightData directionals[MAX_LIGHTS];
+    PointLightData points[MAX_LIGHTS];
+    SpotLightData spots[MAX_LIGHTS];
+};
+
+// `VolumeLight` block: one point/spot light drawn as a proxy mesh. Point
+// lights are sent as spots whose cone covers every direction.
+struct VolumeLightUniforms {
+    glm::mat4 model; // unit proxy mesh -> light volume
+    SpotLightData light;
+};
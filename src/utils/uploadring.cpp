@@ -0,0 +1,155 @@
+#include "uploadring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void UploadRing::init(GLsizeiptr frameSize) {
+    m_useStorage = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+    // Every upload may be bound as a uniform or storage block range
+    GLint uboAlign = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlign);
+    m_alignment = std::max(uboAlign, 16);
+    if (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object) {
+        GLint ssboAlign = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlign);
+        m_alignment = std::max(m_alignment, ssboAlign);
+    }
+
+    create(frameSize);
+    std::cout << "[UploadRing] " << FRAMES << " x " << m_frameSize << " bytes, "
+              << (isPersistent() ? "persistent mapping" : "map/orphan fallback") << std::endl;
+}
+
+void UploadRing::destroy() {
+    release();
+}
+
+void UploadRing::create(GLsizeiptr frameSize) {
+    // Keep every region start aligned
+    m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+    GLsizeiptr totalSize = m_frameSize * FRAMES;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    if (m_useStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+        m_mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+        if (!m_mapped) {
+            // Immutable storage can't be respecified, so start over without it
+            std::cerr << "[UploadRing] persistent mapping failed, using fallback" << std::endl;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &m_buffer);
+            m_useStorage = false;
+            create(frameSize);
+            return;
+        }
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_region = 0;
+    m_cursor = 0;
+    m_overflowed = false;
+}
+
+void UploadRing::release() {
+    for (GLsync &fence : m_fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (m_mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        m_mapped = nullptr;
+    }
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+}
+
+void UploadRing::waitForRegion(int region) {
+    GLsync &fence = m_fences[region];
+    if (!fence) return;
+
+    if (!isPersistent()) {
+        // Don't block: hand the driver the old storage and take fresh memory.
+        // That frees every region at once.
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, m_frameSize * FRAMES, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            for (GLsync &f : m_fences) {
+                if (f) glDeleteSync(f);
+                f = nullptr;
+            }
+            return;
+        }
+    }
+    else {
+        // Flush on the first wait so the fence is guaranteed to signal
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            GLenum result = glClientWaitSync(fence, flags, 1000000); // 1 ms
+            if (result != GL_TIMEOUT_EXPIRED) break;
+            flags = 0;
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void UploadRing::beginFrame() {
+    if (m_overflowed) {
+        // Everything must be idle before the storage can go away
+        glFinish();
+        GLsizeiptr newSize = m_frameSize * 2;
+        release();
+        create(newSize);
+        std::cout << "[UploadRing] frame region grew to " << m_frameSize << " bytes" << std::endl;
+    }
+    else {
+        m_region = (m_region + 1) % FRAMES;
+    }
+
+    waitForRegion(m_region);
+    m_cursor = 0;
+}
+
+void UploadRing::endFrame() {
+    GLsync &fence = m_fences[m_region];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr UploadRing::upload(const void *data, GLsizeiptr size) {
+    GLintptr start = (m_cursor + m_alignment - 1) / m_alignment * m_alignment;
+    if (start + size > m_frameSize) {
+        m_overflowed = true;
+        return INVALID;
+    }
+    m_cursor = start + size;
+
+    GLintptr offset = m_region * m_frameSize + start;
+    if (isPersistent()) {
+        std::memcpy(m_mapped + offset, data, size);
+    }
+    else {
+        // The fence (or the orphan) already guarantees the GPU is done with it
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        void *ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (ptr) {
+            std::memcpy(ptr, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return offset;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+
+// Streaming buffer for data that is rewritten every frame (camera, lights,
+// indirect commands). The buffer is split into FRAMES regions used round
+// robin; a fence at the end of each frame marks when the GPU is done with
+// that frame's region, so writing into it never stalls on an implicit sync.
+//
+// With GL 4.4 / ARB_buffer_storage the whole buffer is mapped once
+// (persistent + coherent) and uploads are plain memcpys. Otherwise each
+// upload maps its range unsynchronized, and the buffer is orphaned instead
+// of waiting when the region we need is still in flight.
+class UploadRing {
+public:
+    static constexpr int FRAMES = 3;
+    static constexpr GLintptr INVALID = -1;
+
+    void init(GLsizeiptr frameSize);
+    void destroy();
+
+    // Claim the next region; waits only if the GPU is still FRAMES frames behind
+    void beginFrame();
+    // Fence everything submitted since beginFrame()
+    void endFrame();
+
+    // Copy `size` bytes into this frame's region. Returns the offset in
+    // getBuffer(), aligned for UBO/SSBO binding, or INVALID if the region is
+    // full (the ring grows at the next beginFrame).
+    GLintptr upload(const void *data, GLsizeiptr size);
+
+    GLuint getBuffer() const { return m_buffer; }
+    bool isPersistent() const { return m_mapped != nullptr; }
+
+private:
+    void create(GLsizeiptr frameSize);
+    void release();
+    void waitForRegion(int region);
+
+    GLuint m_buffer = 0;
+    char *m_mapped = nullptr; // persistent mapping, null on the fallback path
+    bool m_useStorage = false;
+
+    GLsizeiptr m_frameSize = 0;
+    GLint m_alignment = 256;
+
+    int m_region = 0;
+    GLintptr m_cursor = 0; // relative to the current region
+    bool m_overflowed = false;
+
+    std::array<GLsync, FRAMES> m_fences = {};
+};